@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+(function() {
+	var Bench = {
+		benchResetCounters__sig: 'v',
+		benchResetCounters: function() {
+			var counters = Module['benchCounters'];
+			for(var key in counters) counters[key] = 0;
+		},
+
+		benchGetCounters__sig: 'vp',
+		benchGetCounters: function(pCounters) {
+			var counters = Module['benchCounters'];
+			var keys = ['toJs', 'toWasm', 'malloc', 'free', 'objects', 'gcCount', 'gcDuration'];
+			for(var i = 0; i < keys.length; ++i)
+				{{{ makeSetValue('pCounters', 'i*8', 'counters[keys[i]]', 'double') }}};
+		},
+
+		benchWallClock__sig: 'd',
+		benchWallClock: function() {
+			var time = process.hrtime();
+			return time[0] * 1000 + time[1] / 1e6;
+		},
+
+		benchNetworkIdle__sig: 'i',
+		benchNetworkIdle: function() {
+			return Module['netsim'].idle() ? 1 : 0;
+		},
+
+		benchGetNetworkConfig__sig: 'p',
+		benchGetNetworkConfig__deps: ['$stringToNewUTF8'],
+		benchGetNetworkConfig: function() {
+			return stringToNewUTF8(JSON.stringify(Module['netsim'].config));
+		},
+
+		// Size in MiB of an allocation made before the large buffer scenarios, so that their
+		// buffers land at high heap addresses
+		benchGetBallast__sig: 'i',
+		benchGetBallast: function() {
+			return Number(process.env['DATACHANNEL_WASM_BENCH_BALLAST'] || 0);
+		},
+
+		benchFinish__sig: 'vi',
+		benchFinish: function(failures) {
+			Module['benchGcObserver'].disconnect();
+			if(failures) process.exitCode = 1;
+		},
+	};
+
+	mergeInto(LibraryManager.library, Bench);
+})();
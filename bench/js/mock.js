@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// In-process mock of the browser runtime for Node. WebSockets connect to an echo server, while
+// peer connections are provided by the network simulator in js/netsim.js which must be loaded
+// first. It also counts JS/wasm crossings, malloc calls, typed arrays and buffers created, and GC
+// pauses for the benchmark suite.
+
+(function() {
+	var counters = Module['benchCounters'] = {
+		toJs: 0,
+		toWasm: 0,
+		malloc: 0,
+		free: 0,
+		objects: 0,
+		gcCount: 0,
+		gcDuration: 0,
+	};
+
+	var pending = [];
+	var scheduled = false;
+	var flush = function() {
+		scheduled = false;
+		var tasks = pending;
+		pending = [];
+		for(var i = 0; i < tasks.length; ++i) tasks[i]();
+	};
+	var schedule = function(task) {
+		pending.push(task);
+		if(!scheduled) {
+			scheduled = true;
+			setImmediate(flush);
+		}
+	};
+
+	var byteLength = function(data) {
+		return typeof data == 'string' ? Buffer.byteLength(data) : data.byteLength;
+	};
+
+	var copyData = function(data) {
+		if(typeof data == 'string') return data;
+		if(data instanceof ArrayBuffer) return data.slice(0);
+		return data.slice().buffer; // Copy the view as the browser does
+	};
+
+	// WebSockets connect to an in-process echo server
+
+	function MockWebSocket(url) {
+		this.url = url;
+		this.readyState = 0;
+		this.bufferedAmount = 0;
+		this.binaryType = 'blob';
+		var self = this;
+		schedule(function() {
+			if(self.readyState != 0) return;
+			self.readyState = 1;
+			if(self.onopen) self.onopen();
+		});
+	}
+
+	MockWebSocket.CONNECTING = 0;
+	MockWebSocket.OPEN = 1;
+	MockWebSocket.CLOSING = 2;
+	MockWebSocket.CLOSED = 3;
+
+	MockWebSocket.prototype.send = function(data) {
+		if(this.readyState != 1) throw new Error('InvalidStateError');
+		var self = this;
+		var size = byteLength(data);
+		var copy = copyData(data);
+		this.bufferedAmount += size;
+		schedule(function() {
+			self.bufferedAmount -= size;
+			if(self.readyState == 1 && self.onmessage) self.onmessage({data: copy});
+		});
+	};
+
+	MockWebSocket.prototype.close = function() {
+		if(this.readyState >= 2) return;
+		this.readyState = 3;
+		var self = this;
+		schedule(function() {
+			if(self.onclose) self.onclose();
+		});
+	};
+
+	// Typed arrays and buffers are the JS objects the glue may create on the messaging path, so
+	// count them by wrapping their constructors
+	['ArrayBuffer', 'Uint8Array'].forEach(function(name) {
+		globalThis[name] = new Proxy(globalThis[name], {
+			construct: function(target, args, newTarget) {
+				++counters.objects;
+				return Reflect.construct(target, args, newTarget);
+			},
+		});
+	});
+
+	globalThis.window = globalThis;
+	globalThis.WebSocket = MockWebSocket;
+
+	// Count crossings by wrapping the glue imports and dispatch exports of the instance: imports
+	// are prefixed webrtc and ws by their library, except the rtc object, heap and log helpers
+	var wrapImports = function(imports) {
+		var env = {};
+		Object.keys(imports.env).forEach(function(name) {
+			var f = imports.env[name];
+			if(typeof f == 'function' && /^(webrtc|ws|rtc)[A-Z]/.test(name)) {
+				env[name] = function() {
+					++counters.toJs;
+					return f.apply(null, arguments);
+				};
+			} else {
+				env[name] = f;
+			}
+		});
+		var wrapped = Object.assign({}, imports);
+		wrapped.env = env;
+		return wrapped;
+	};
+
+	var wrapExports = function(exports) {
+		var wrapped = {};
+		Object.keys(exports).forEach(function(name) {
+			var f = exports[name];
+			if(typeof f != 'function') {
+				wrapped[name] = f;
+			} else if(/^(rtc|ws)Dispatch/.test(name) || name == 'rtcAllocMessageBuffer') {
+				wrapped[name] = function() {
+					++counters.toWasm;
+					return f.apply(null, arguments);
+				};
+			} else if(name == 'malloc') {
+				wrapped[name] = function(size) {
+					++counters.malloc;
+					return f(size);
+				};
+			} else if(name == 'free') {
+				wrapped[name] = function(ptr) {
+					if(ptr) ++counters.free;
+					return f(ptr);
+				};
+			} else {
+				wrapped[name] = f;
+			}
+		});
+		return wrapped;
+	};
+
+	Module['instantiateWasm'] = function(imports, receiveInstance) {
+		var fs = require('fs');
+		var path = require('path');
+		var file = Module['locateFile'] ? Module['locateFile']('datachannel-wasm-bench.wasm', __dirname + '/')
+		                                : path.join(__dirname, 'datachannel-wasm-bench.wasm');
+		WebAssembly.instantiate(fs.readFileSync(file), wrapImports(imports))
+			.then(function(result) {
+				receiveInstance({exports: wrapExports(result.instance.exports)}, result.module);
+			});
+		return {};
+	};
+
+	var perfHooks = require('perf_hooks');
+	var gcObserver = new perfHooks.PerformanceObserver(function(list) {
+		list.getEntries().forEach(function(entry) {
+			++counters.gcCount;
+			counters.gcDuration += entry.duration;
+		});
+	});
+	gcObserver.observe({entryTypes: ['gc']});
+	Module['benchGcObserver'] = gcObserver;
+})();
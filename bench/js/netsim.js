@@ -0,0 +1,449 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Deterministic loopback network simulator standing in for RTCPeerConnection and RTCDataChannel.
+//
+// Peer connections created from the same simulator exchange offer/answer and candidates
+// in-process and connect to each other. Data channel messages go through a simulated link with
+// configurable latency, jitter, loss, bandwidth and maximum message size, honouring ordering and
+// partial reliability (maxRetransmits, maxPacketLifeTime). Random draws come from a seeded
+// generator and, with virtualTime, the clock only advances from event to event, so runs are
+// reproducible. Reliable retransmissions add delay but do not consume bandwidth.
+//
+// When loaded as a pre-js, the simulator is created from Module['netsim'] or from the
+// DATACHANNEL_WASM_NETSIM environment variable (JSON) and installed as Module['RTCPeerConnection'].
+
+(function() {
+	var DefaultConfig = {
+		seed: 1,
+		latency: 0,               // one-way latency in ms
+		jitter: 0,                // additional uniformly random latency in ms
+		loss: 0,                  // packet loss probability
+		bandwidth: 0,             // bytes per second in each direction, 0 for unlimited
+		maxMessageSize: 262144,   // bytes
+		mtu: 1200,                // bytes per packet for loss computation
+		retransmissionTimeout: 0, // ms, 0 for twice the round-trip time (at least 10ms)
+		virtualTime: true,
+	};
+
+	function NetSim(config) {
+		var self = this;
+		this.config = Object.assign({}, DefaultConfig, config || {});
+		this.state = (this.config.seed >>> 0) || 1;
+		this.time = 0;
+		this.sequence = 0;
+		this.events = [];
+		this.running = false;
+		this.realStart = Date.now();
+		this.peerConnections = {};
+		this.nextPeerConnectionId = 1;
+		this.stats = {sent: 0, delivered: 0, dropped: 0, retransmissions: 0};
+
+		var sim = this;
+		this.RTCPeerConnection = function(config) {
+			SimPeerConnection.call(this, sim, config);
+		};
+		this.RTCPeerConnection.prototype = Object.create(SimPeerConnection.prototype);
+		this.RTCPeerConnection.prototype.constructor = this.RTCPeerConnection;
+		this.RTCDataChannel = SimDataChannel;
+	}
+
+	// mulberry32
+	NetSim.prototype.random = function() {
+		var t = (this.state = (this.state + 0x6D2B79F5) >>> 0);
+		t = Math.imul(t ^ (t >>> 15), t | 1);
+		t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+		return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+	};
+
+	NetSim.prototype.now = function() {
+		return this.config.virtualTime ? this.time : Date.now() - this.realStart;
+	};
+
+	NetSim.prototype.idle = function() {
+		return this.events.length == 0;
+	};
+
+	NetSim.prototype.schedule = function(time, task) {
+		var event = {time: Math.max(time, this.now()), sequence: this.sequence++, task: task};
+		// Keep events sorted by time then sequence, insertion from the end is cheap in practice
+		var i = this.events.length;
+		while(i > 0 && (this.events[i-1].time > event.time ||
+		                (this.events[i-1].time == event.time && this.events[i-1].sequence > event.sequence)))
+			--i;
+		this.events.splice(i, 0, event);
+		this.wake();
+	};
+
+	NetSim.prototype.defer = function(task) {
+		this.schedule(this.now(), task);
+	};
+
+	NetSim.prototype.wake = function() {
+		if(this.running || this.events.length == 0) return;
+		this.running = true;
+		var self = this;
+		var delay = this.config.virtualTime ? 0 : Math.max(0, this.events[0].time - this.now());
+		var run = function() {
+			self.running = false;
+			self.step();
+			self.wake();
+		};
+		if(delay == 0 && typeof setImmediate != 'undefined') setImmediate(run);
+		else setTimeout(run, delay);
+	};
+
+	// Run all events due at the earliest time, letting other JS tasks interleave between steps
+	NetSim.prototype.step = function() {
+		if(this.events.length == 0) return;
+		var time = this.events[0].time;
+		if(!this.config.virtualTime && time > this.now()) return;
+		if(this.config.virtualTime) this.time = Math.max(this.time, time);
+		while(this.events.length > 0 && this.events[0].time <= time) {
+			var event = this.events.shift();
+			event.task();
+		}
+	};
+
+	// Compute the fate of a message: its arrival time or null if it is abandoned
+	NetSim.prototype.transmit = function(link, channel, size) {
+		var config = this.config;
+		var now = this.now();
+		var start = Math.max(now, link.freeAt);
+		var duration = config.bandwidth > 0 ? size * 1000 / config.bandwidth : 0;
+		link.freeAt = start + duration;
+
+		var packets = Math.max(1, Math.ceil(size / config.mtu));
+		var lossProbability = 1 - Math.pow(1 - config.loss, packets);
+		var rtt = 2 * config.latency + config.jitter;
+		var rto = config.retransmissionTimeout > 0 ? config.retransmissionTimeout : Math.max(10, 2 * rtt);
+
+		var attemptTime = link.freeAt;
+		var retransmits = 0;
+		while(this.random() < lossProbability) {
+			attemptTime += rto;
+			++retransmits;
+			if(channel.maxRetransmits !== null && retransmits > channel.maxRetransmits) return null;
+			if(channel.maxPacketLifeTime !== null && attemptTime - now > channel.maxPacketLifeTime)
+				return null;
+		}
+		this.stats.retransmissions += retransmits;
+		return {
+			sent: link.freeAt,
+			arrival: attemptTime + config.latency + this.random() * config.jitter,
+		};
+	};
+
+	NetSim.prototype.install = function(module) {
+		module['RTCPeerConnection'] = this.RTCPeerConnection;
+		module['netsim'] = this;
+		if(this.config.virtualTime && typeof performance != 'undefined') {
+			var self = this;
+			performance.now = function() {
+				return self.now();
+			};
+		}
+	};
+
+	// Data channels
+
+	function SimDataChannel(peerConnection, label, init) {
+		init = init || {};
+		if(init.maxRetransmits !== undefined && init.maxPacketLifeTime !== undefined)
+			throw new TypeError('maxRetransmits and maxPacketLifeTime are exclusive');
+		this.label = label;
+		this.ordered = init.ordered !== undefined ? !!init.ordered : true;
+		this.maxRetransmits = init.maxRetransmits !== undefined ? init.maxRetransmits : null;
+		this.maxPacketLifeTime = init.maxPacketLifeTime !== undefined ? init.maxPacketLifeTime : null;
+		this.negotiated = !!init.negotiated;
+		this.id = init.id !== undefined ? init.id : null;
+		this.priority = init.priority || 'low';
+		this.protocol = init.protocol || '';
+		this.readyState = 'connecting';
+		this.bufferedAmount = 0;
+		this.bufferedAmountLowThreshold = 0;
+		this.binaryType = 'blob';
+		this.peerConnection = peerConnection;
+		this.sim = peerConnection.sim;
+		this.remote = null;
+		this.lastDelivery = 0;
+	}
+
+	SimDataChannel.prototype.open = function() {
+		if(this.readyState != 'connecting') return;
+		this.readyState = 'open';
+		if(this.onopen) this.onopen();
+	};
+
+	SimDataChannel.prototype.send = function(data) {
+		if(this.readyState != 'open') throw new Error('InvalidStateError');
+		var size = typeof data == 'string' ? Buffer.byteLength(data) : data.byteLength;
+		if(size > this.sim.config.maxMessageSize) throw new TypeError('Message too large');
+
+		var copy;
+		if(typeof data == 'string') copy = data;
+		else if(data instanceof ArrayBuffer) copy = data.slice(0);
+		else copy = data.slice().buffer; // Copy the view as the browser does
+
+		var sim = this.sim;
+		var self = this;
+		var remote = this.remote;
+		var fate = sim.transmit(this.peerConnection.link, this, size);
+		++sim.stats.sent;
+		this.bufferedAmount += size;
+
+		sim.schedule(fate ? fate.sent : this.peerConnection.link.freeAt, function() {
+			var previous = self.bufferedAmount;
+			self.bufferedAmount -= size;
+			if(previous > self.bufferedAmountLowThreshold &&
+			   self.bufferedAmount <= self.bufferedAmountLowThreshold &&
+			   self.readyState == 'open' && self.onbufferedamountlow)
+				self.onbufferedamountlow();
+		});
+
+		if(!fate) {
+			++sim.stats.dropped;
+			return;
+		}
+
+		// Ordered channels deliver in sequence, later messages wait for earlier ones
+		var delivery = fate.arrival;
+		if(this.ordered) {
+			delivery = Math.max(delivery, this.lastDelivery);
+			this.lastDelivery = delivery;
+		}
+		sim.schedule(delivery, function() {
+			if(remote.readyState != 'open') return;
+			++sim.stats.delivered;
+			if(remote.onmessage) remote.onmessage({data: copy});
+		});
+	};
+
+	SimDataChannel.prototype.close = function() {
+		if(this.readyState == 'closed') return;
+		this.readyState = 'closed';
+		var self = this;
+		this.sim.defer(function() {
+			if(self.onclose) self.onclose();
+		});
+		if(this.remote) this.remote.close();
+	};
+
+	// Peer connections
+
+	function SimPeerConnection(sim, config) {
+		this.sim = sim;
+		this.config = config;
+		this.connectionState = 'new';
+		this.iceConnectionState = 'new';
+		this.iceGatheringState = 'new';
+		this.signalingState = 'stable';
+		this.localDescription = null;
+		this.remoteDescription = null;
+		this.simId = sim.nextPeerConnectionId++;
+		this.remotePeer = null;
+		this.connected = false;
+		this.negotiationNeeded = false;
+		this.pendingChannels = [];
+		this.negotiatedChannels = [];
+		this.link = {freeAt: 0};
+		sim.peerConnections[this.simId] = this;
+	}
+
+	SimPeerConnection.prototype.setState = function(name, value) {
+		if(this[name] == value) return;
+		this[name] = value;
+		var handler = {
+			connectionState: 'onconnectionstatechange',
+			iceConnectionState: 'oniceconnectionstatechange',
+			iceGatheringState: 'onicegatheringstatechange',
+			signalingState: 'onsignalingstatechange',
+		}[name];
+		if(this[handler]) this[handler]();
+	};
+
+	SimPeerConnection.prototype.createDataChannel = function(label, init) {
+		var channel = new SimDataChannel(this, label, init);
+		if(channel.negotiated) {
+			this.negotiatedChannels.push(channel);
+			if(this.connected) this.pairNegotiated();
+		} else if(this.connected) {
+			this.connectChannel(channel);
+		} else {
+			this.pendingChannels.push(channel);
+		}
+		if(!this.connected && !this.negotiationNeeded) {
+			this.negotiationNeeded = true;
+			var self = this;
+			this.sim.defer(function() {
+				if(self.onnegotiationneeded) self.onnegotiationneeded();
+			});
+		}
+		return channel;
+	};
+
+	SimPeerConnection.prototype.createDescription = function(type) {
+		return Promise.resolve({
+			type: type,
+			sdp: 'v=0\r\no=netsim ' + this.simId + ' 0 IN IP4 127.0.0.1\r\n',
+		});
+	};
+
+	SimPeerConnection.prototype.createOffer = function() {
+		return this.createDescription('offer');
+	};
+
+	SimPeerConnection.prototype.createAnswer = function() {
+		return this.createDescription('answer');
+	};
+
+	SimPeerConnection.prototype.setLocalDescription = function(description) {
+		this.localDescription = {type: description.type, sdp: description.sdp};
+		this.setState('signalingState', description.type == 'offer' ? 'have-local-offer' : 'stable');
+		var self = this;
+		this.sim.defer(function() {
+			self.setState('iceGatheringState', 'gathering');
+			if(self.onicecandidate)
+				self.onicecandidate({
+					candidate: {
+						candidate: 'candidate:1 1 UDP 2122252543 127.0.0.' + self.simId + ' 9 typ host',
+						sdpMid: '0',
+					},
+				});
+			if(self.onicecandidate) self.onicecandidate({candidate: null});
+			self.setState('iceGatheringState', 'complete');
+			self.tryConnect();
+		});
+		return Promise.resolve();
+	};
+
+	SimPeerConnection.prototype.setRemoteDescription = function(description) {
+		var match = /o=netsim (\d+)/.exec(description.sdp);
+		if(!match || !this.sim.peerConnections[match[1]])
+			return Promise.reject(new Error('Unknown remote peer'));
+		this.remoteDescription = {type: description.type, sdp: description.sdp};
+		this.remotePeer = this.sim.peerConnections[match[1]];
+		this.setState('signalingState', description.type == 'offer' ? 'have-remote-offer' : 'stable');
+		var self = this;
+		this.sim.defer(function() {
+			self.tryConnect();
+		});
+		return Promise.resolve();
+	};
+
+	SimPeerConnection.prototype.addIceCandidate = function() {
+		return Promise.resolve();
+	};
+
+	SimPeerConnection.prototype.tryConnect = function() {
+		var remote = this.remotePeer;
+		if(this.connected || !remote || remote.remotePeer !== this) return;
+		if(!this.localDescription || !this.remoteDescription) return;
+		if(!remote.localDescription || !remote.remoteDescription) return;
+		var self = this;
+		var peers = [this, remote];
+		peers.forEach(function(pc) {
+			pc.connected = true;
+			pc.setState('iceConnectionState', 'checking');
+			pc.setState('connectionState', 'connecting');
+		});
+		// Connectivity checks and DTLS handshake take a couple of round trips
+		var rtt = 2 * this.sim.config.latency;
+		this.sim.schedule(this.sim.now() + 2 * rtt, function() {
+			peers.forEach(function(pc) {
+				pc.setState('iceConnectionState', 'connected');
+				pc.setState('connectionState', 'connected');
+			});
+			peers.forEach(function(pc) {
+				var channels = pc.pendingChannels;
+				pc.pendingChannels = [];
+				channels.forEach(function(channel) {
+					pc.connectChannel(channel);
+				});
+			});
+			self.pairNegotiated();
+		});
+	};
+
+	SimPeerConnection.prototype.connectChannel = function(channel) {
+		var sim = this.sim;
+		var remotePeer = this.remotePeer;
+		var remote = new SimDataChannel(remotePeer, channel.label, {
+			ordered: channel.ordered,
+			maxRetransmits: channel.maxRetransmits !== null ? channel.maxRetransmits : undefined,
+			maxPacketLifeTime: channel.maxPacketLifeTime !== null ? channel.maxPacketLifeTime : undefined,
+			priority: channel.priority,
+			protocol: channel.protocol,
+		});
+		channel.remote = remote;
+		remote.remote = channel;
+		// DCEP open and ack take a round trip
+		sim.schedule(sim.now() + sim.config.latency, function() {
+			if(remotePeer.ondatachannel) remotePeer.ondatachannel({channel: remote});
+			sim.defer(function() {
+				remote.open();
+			});
+		});
+		sim.schedule(sim.now() + 2 * sim.config.latency, function() {
+			channel.open();
+		});
+	};
+
+	// Negotiated channels are paired by id once both sides have created them
+	SimPeerConnection.prototype.pairNegotiated = function() {
+		var remotePeer = this.remotePeer;
+		if(!this.connected || !remotePeer || !remotePeer.connected) return;
+		var sim = this.sim;
+		this.negotiatedChannels.slice().forEach(function(channel) {
+			for(var i = 0; i < remotePeer.negotiatedChannels.length; ++i) {
+				var remote = remotePeer.negotiatedChannels[i];
+				if(remote.id !== channel.id) continue;
+				channel.remote = remote;
+				remote.remote = channel;
+				remotePeer.negotiatedChannels.splice(i, 1);
+				this.negotiatedChannels.splice(this.negotiatedChannels.indexOf(channel), 1);
+				sim.defer(function() {
+					channel.open();
+					remote.open();
+				});
+				break;
+			}
+		}, this);
+	};
+
+	SimPeerConnection.prototype.close = function() {
+		if(this.connectionState == 'closed') return;
+		this.connected = false;
+		this.setState('iceConnectionState', 'closed');
+		this.setState('connectionState', 'closed');
+		delete this.sim.peerConnections[this.simId];
+	};
+
+	globalThis.NetSim = NetSim;
+
+	if(typeof Module != 'undefined' && !Module['netsim']) {
+		var env = typeof process != 'undefined' ? process.env['DATACHANNEL_WASM_NETSIM'] : undefined;
+		new NetSim(env ? JSON.parse(env) : {}).install(Module);
+	} else if(typeof Module != 'undefined' && !(Module['netsim'] instanceof NetSim)) {
+		new NetSim(Module['netsim']).install(Module);
+	}
+})();
@@ -0,0 +1,223 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Replay driver for captures recorded with rtc::Capture, feeding the recorded traffic through
+// the network simulator in js/netsim.js at the original or an accelerated speed:
+//
+//   node replay.js capture.bin [speed]
+//
+// Sent events are replayed from one peer and received events from the other, on negotiated
+// data channels standing in for the captured streams. The network is configured with the
+// DATACHANNEL_WASM_NETSIM environment variable, and results are output as JSON.
+//
+// Capture format: the 6 bytes "RTCCAP", a version byte (1) and a reserved byte, followed by
+// records each starting with a flags byte:
+//   0x08 stream definition: varint label length, label (UTF-8), streams being numbered in order
+//   otherwise an event, 0x01 received (else sent), 0x02 string, 0x04 payload included:
+//     varint time since the previous event in microseconds, varint stream, varint size,
+//     and the payload if included
+// Varints are LEB128.
+
+(function() {
+	var fs = require('fs');
+	var path = require('path');
+	require(path.join(__dirname, 'netsim.js'));
+
+	function parseCapture(bytes) {
+		var offset = 0;
+		var readVarint = function() {
+			var value = 0;
+			var shift = 1;
+			var b;
+			do {
+				if(offset >= bytes.length) throw new Error('Truncated capture');
+				b = bytes[offset++];
+				value += (b & 0x7F) * shift;
+				shift *= 128;
+			} while(b & 0x80);
+			return value;
+		};
+		var read = function(size) {
+			if(offset + size > bytes.length) throw new Error('Truncated capture');
+			var view = bytes.subarray(offset, offset + size);
+			offset += size;
+			return view;
+		};
+
+		if(Buffer.from(read(6)).toString() != 'RTCCAP') throw new Error('Not a capture');
+		var version = read(2)[0];
+		if(version != 1) throw new Error('Unsupported capture version ' + version);
+
+		var streams = [];
+		var events = [];
+		var time = 0;
+		while(offset < bytes.length) {
+			var flags = read(1)[0];
+			if(flags & 0x08) {
+				streams.push(Buffer.from(read(readVarint())).toString());
+				continue;
+			}
+			time += readVarint() / 1000;
+			var event = {
+				time: time,
+				stream: readVarint(),
+				received: !!(flags & 0x01),
+				string: !!(flags & 0x02),
+				size: 0,
+				payload: null,
+			};
+			event.size = readVarint();
+			if(flags & 0x04) event.payload = read(event.size).slice();
+			events.push(event);
+		}
+		return {streams: streams, events: events};
+	}
+
+	function connect(sim) {
+		var pc1 = new sim.RTCPeerConnection({});
+		var pc2 = new sim.RTCPeerConnection({});
+		return {
+			pc1: pc1,
+			pc2: pc2,
+			start: function() {
+				pc1.createOffer()
+					.then(function(offer) { return pc1.setLocalDescription(offer); })
+					.then(function() { return pc2.setRemoteDescription(pc1.localDescription); })
+					.then(function() { return pc2.createAnswer(); })
+					.then(function(answer) { return pc2.setLocalDescription(answer); })
+					.then(function() { return pc1.setRemoteDescription(pc2.localDescription); });
+			},
+		};
+	}
+
+	function percentile(sorted, p) {
+		if(sorted.length == 0) return 0;
+		return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+	}
+
+	function replay(capture, speed, config) {
+		var sim = new NetSim(config);
+		var peers = connect(sim);
+		var pairs = capture.streams.map(function(label, index) {
+			var init = {negotiated: true, id: index};
+			return [peers.pc1.createDataChannel(label, init), peers.pc2.createDataChannel(label, init)];
+		});
+
+		var stats = {sent: 0, delivered: 0, failed: 0, bytes: 0};
+		var latencies = [];
+		var pending = 0;
+		var finish = function() {
+			latencies.sort(function(a, b) { return a - b; });
+			var mean = latencies.reduce(function(a, b) { return a + b; }, 0) / (latencies.length || 1);
+			var events = capture.events;
+			var result = {
+				network: sim.config,
+				speed: speed,
+				streams: capture.streams,
+				events: events.length,
+				capture_ms: events.length ? events[events.length - 1].time : 0,
+				replay_ms: sim.now() - start,
+				sent: stats.sent,
+				delivered: stats.delivered,
+				failed: stats.failed,
+				bytes: stats.bytes,
+				latency_ms_mean: mean,
+				latency_ms_p50: percentile(latencies, 0.5),
+				latency_ms_p99: percentile(latencies, 0.99),
+			};
+			process.stdout.write(JSON.stringify(result) + '\n');
+			pairs.forEach(function(pair) { pair[0].close(); });
+		};
+
+		// Ordered channels deliver in sequence, so send times are matched in order
+		pairs.forEach(function(pair) {
+			pair.forEach(function(channel) {
+				channel.rtcSendTimes = [];
+				channel.onmessage = function() {
+					var sent = channel.remote.rtcSendTimes.shift();
+					if(sent !== undefined) latencies.push(sim.now() - sent);
+					++stats.delivered;
+				};
+			});
+		});
+
+		var start = 0;
+		var run = function() {
+			start = sim.now();
+			pending = capture.events.length;
+			if(pending == 0) return finish();
+			capture.events.forEach(function(event) {
+				sim.schedule(start + event.time / speed, function() {
+					var pair = pairs[event.stream];
+					var channel = pair && pair[event.received ? 1 : 0];
+					var data;
+					if(event.string)
+						data = event.payload ? Buffer.from(event.payload).toString() : 'x'.repeat(event.size);
+					else
+						data = event.payload ? event.payload : new Uint8Array(event.size);
+					try {
+						channel.send(data);
+						channel.rtcSendTimes.push(sim.now());
+						++stats.sent;
+						stats.bytes += event.size;
+					} catch(e) {
+						++stats.failed;
+					}
+					if(--pending == 0) waitIdle();
+				});
+			});
+		};
+		var waitIdle = function() {
+			if(sim.idle()) finish();
+			else setImmediate(waitIdle);
+		};
+
+		// Start once every channel is open on both sides
+		var waitOpen = function() {
+			var open = pairs.every(function(pair) {
+				return pair[0].readyState == 'open' && pair[1].readyState == 'open';
+			});
+			if(open) run();
+			else setImmediate(waitOpen);
+		};
+		peers.start();
+		waitOpen();
+	}
+
+	if(require.main === module) {
+		var args = process.argv.slice(2);
+		if(args.length < 1) {
+			process.stderr.write('Usage: node replay.js capture [speed]\n');
+			process.exit(1);
+		}
+		var speed = args.length > 1 ? parseFloat(args[1]) : 1;
+		if(!(speed > 0)) {
+			process.stderr.write('Speed must be positive\n');
+			process.exit(1);
+		}
+		var env = process.env['DATACHANNEL_WASM_NETSIM'];
+		var capture = parseCapture(new Uint8Array(fs.readFileSync(args[0])));
+		replay(capture, speed, env ? JSON.parse(env) : {});
+	}
+
+	module.exports = {parseCapture: parseCapture, replay: replay};
+})();
@@ -0,0 +1,556 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Benchmark suite running the library under Node against the mock browser runtime in js/mock.js
+// and the network simulator in js/netsim.js. Results are printed to stdout as JSON.
+
+#include "rtc/rtc.hpp"
+
+#include <emscripten/emscripten.h>
+
+#ifndef __EMSCRIPTEN__
+#include "rtc/native.hpp"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <new>
+
+extern "C" {
+extern void benchResetCounters();
+extern void benchGetCounters(double *counters);
+extern double benchWallClock();
+extern int benchNetworkIdle();
+extern char *benchGetNetworkConfig();
+extern int benchGetBallast();
+extern void benchFinish(int failures);
+#ifndef __EMSCRIPTEN__
+extern int benchExitCode();
+#endif
+}
+
+namespace {
+
+std::size_t allocations = 0;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+#ifndef __EMSCRIPTEN__
+	// The fake transport stands for the browser, whose allocations the glue counters cover
+	if (!rtc::native::inTransport())
+		++allocations;
+#else
+	++allocations;
+#endif
+	if (void *ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+using namespace rtc;
+using std::function;
+
+enum class Transport { DataChannel, WebSocket };
+
+struct Scenario {
+	Transport transport;
+	size_t channels;
+	size_t size;
+	bool text;
+	size_t count;
+	const char *mode = "reliable";
+	Reliability reliability = {};
+	bool broadcast = false;
+	bool large = false;
+	bool buffers = false; // Receive with onMessageBuffer instead of onMessage
+};
+
+struct Counters {
+	double toJs;
+	double toWasm;
+	double malloc;
+	double free;
+	double objects;
+	double gcCount;
+	double gcDuration;
+};
+
+const size_t TotalBytes = 8 * 1024 * 1024;
+const size_t MinCount = 1000;
+const size_t MaxCount = 100000;
+const size_t Window = 256;
+const size_t MaxInFlight = 64 * 1024 * 1024;
+
+// Heap views may be recreated a few times per scenario, for instance after memory growth
+const size_t ObjectSlack = 4;
+
+// Messages received before checking that the library no longer allocates, as message buffer
+// slabs and containers grow at first
+const size_t WarmupCount = 2 * Window;
+
+class Bench {
+public:
+	void run();
+
+private:
+	void connect();
+	void prepareChannels(function<void()> done);
+	void prepareWebSocket(function<void()> done);
+	void next();
+	void start();
+	void pump();
+	void received(const byte *data, size_t size, bool isString);
+	bool verify(const byte *data, size_t size) const;
+	void poll();
+	void finish();
+
+	shared_ptr<PeerConnection> mPc1;
+	shared_ptr<PeerConnection> mPc2;
+	std::vector<shared_ptr<Channel>> mSenders;
+	std::vector<shared_ptr<Channel>> mReceivers;
+	shared_ptr<Channel> mDedicatedSender;
+	shared_ptr<Channel> mDedicatedReceiver;
+	string mDedicatedLabel;
+	shared_ptr<WebSocket> mWebSocket;
+	function<void()> mReady;
+
+	std::deque<Scenario> mScenarios;
+	Scenario mScenario = {};
+	std::vector<shared_ptr<Channel>> mActiveSenders;
+	std::vector<shared_ptr<Channel>> mActiveReceivers;
+	std::vector<shared_ptr<DataChannel>> mBroadcastTargets;
+	string mText;
+	MessageBuffer mTextBuffer;
+	binary mBinary;
+	void *mBallast = nullptr;
+	std::vector<double> mLatencies;
+	size_t mWindow = Window;
+	size_t mSent = 0;
+	size_t mReceived = 0;
+	size_t mReceivedBytes = 0;
+	double mStartTime = 0;
+	double mStartWallClock = 0;
+	size_t mStartAllocations = 0;
+	size_t mSteadyAllocations = 0;
+	bool mFinished = false;
+	bool mCorrupted = false;
+	bool mFirstResult = true;
+	int mFailures = 0;
+};
+
+void Bench::run() {
+	for (Transport transport : {Transport::DataChannel, Transport::WebSocket})
+		for (size_t channels : {1, 4, 16}) {
+			if (transport == Transport::WebSocket && channels > 1)
+				continue;
+
+			for (bool text : {false, true})
+				for (size_t size : {16, 256, 4096, 65536}) {
+					size_t count = std::clamp(TotalBytes / size, MinCount, MaxCount);
+					mScenarios.push_back({transport, channels, size, text, count});
+				}
+		}
+
+	// Partial reliability scenarios, only meaningful with a lossy simulated network
+	Reliability unordered;
+	unordered.unordered = true;
+	Reliability noRetransmit = unordered;
+	noRetransmit.maxRetransmits = 0;
+	Reliability lifetime = unordered;
+	lifetime.maxPacketLifeTime = std::chrono::milliseconds(100);
+	for (auto [mode, reliability] : {std::pair("unordered", unordered),
+	                                 std::pair("max-retransmits-0", noRetransmit),
+	                                 std::pair("max-packet-lifetime-100", lifetime)})
+		mScenarios.push_back({Transport::DataChannel, 1, 256, false, MinCount, mode, reliability});
+
+	// Fan-out of the same payload to every channel with a single call
+	for (size_t channels : {4, 16})
+		for (size_t size : {256, 4096}) {
+			size_t count = std::clamp(TotalBytes / size, MinCount, MaxCount);
+			mScenarios.push_back(
+			    {Transport::DataChannel, channels, size, false, count, "broadcast", {}, true});
+		}
+
+	// Large buffers, at high heap addresses if a ballast is configured, with payloads verified
+	mScenarios.push_back({Transport::DataChannel, 1, 256 * 1024, false, 256, "large", {}, false,
+	                      true});
+	mScenarios.push_back({Transport::WebSocket, 1, 16 * 1024 * 1024, false, 16, "large", {}, false,
+	                      true});
+
+	// Tiny messages received as buffers, for which the library must not allocate once warmed up
+	for (Transport transport : {Transport::DataChannel, Transport::WebSocket})
+		for (bool text : {false, true})
+			for (size_t size : {16, 64}) {
+				size_t count = std::clamp(TotalBytes / size, MinCount, MaxCount);
+				mScenarios.push_back(
+				    {transport, 1, size, text, count, "buffer", {}, false, false, true});
+			}
+
+	char *network = benchGetNetworkConfig();
+	std::printf("{\"network\":%s,\"results\":[", network);
+	std::free(network);
+	connect();
+	next();
+}
+
+void Bench::connect() {
+	mPc1 = std::make_shared<PeerConnection>();
+	mPc2 = std::make_shared<PeerConnection>();
+
+	mPc1->onLocalDescription([this](Description d) { mPc2->setRemoteDescription(d); });
+	mPc1->onLocalCandidate([this](Candidate c) { mPc2->addRemoteCandidate(c); });
+	mPc2->onLocalDescription([this](Description d) { mPc1->setRemoteDescription(d); });
+	mPc2->onLocalCandidate([this](Candidate c) { mPc1->addRemoteCandidate(c); });
+
+	mPc2->onDataChannel([this](shared_ptr<DataChannel> dc) {
+		if (dc->label() == mDedicatedLabel)
+			mDedicatedReceiver = dc;
+		else
+			mReceivers.push_back(dc);
+
+	});
+}
+
+void Bench::prepareChannels(function<void()> done) {
+	const Scenario &s = mScenario;
+	if (s.reliability.unordered || s.reliability.maxRetransmits ||
+	    s.reliability.maxPacketLifeTime) {
+		if (mDedicatedLabel.empty()) {
+			mDedicatedLabel = string("bench-") + s.mode;
+			mDedicatedReceiver.reset();
+			DataChannelInit init;
+			init.reliability = s.reliability;
+			mDedicatedSender = mPc1->createDataChannel(mDedicatedLabel, init);
+		}
+		if (mDedicatedReceiver && mDedicatedSender->isOpen() && mDedicatedReceiver->isOpen()) {
+			mActiveSenders = {mDedicatedSender};
+			mActiveReceivers = {mDedicatedReceiver};
+			done();
+			return;
+		}
+	} else {
+		size_t count = s.channels;
+		while (mSenders.size() < count)
+			mSenders.push_back(mPc1->createDataChannel("bench-" + std::to_string(mSenders.size())));
+		if (mReceivers.size() >= count &&
+		    std::all_of(mSenders.begin(), mSenders.begin() + count,
+		                [](const auto &dc) { return dc->isOpen(); }) &&
+		    std::all_of(mReceivers.begin(), mReceivers.begin() + count,
+		                [](const auto &dc) { return dc->isOpen(); })) {
+			mActiveSenders.assign(mSenders.begin(), mSenders.begin() + count);
+			mActiveReceivers.assign(mReceivers.begin(), mReceivers.begin() + count);
+			done();
+			return;
+		}
+	}
+
+	// Poll until every channel is open on both sides
+	mReady = std::move(done);
+	emscripten_async_call(
+	    [](void *arg) {
+		    auto *bench = static_cast<Bench *>(arg);
+		    bench->prepareChannels(std::move(bench->mReady));
+	    },
+	    this, 1);
+}
+
+void Bench::prepareWebSocket(function<void()> done) {
+	if (mWebSocket && mWebSocket->isOpen()) {
+		mActiveSenders = {mWebSocket};
+		mActiveReceivers = {mWebSocket};
+		done();
+		return;
+	}
+
+	mWebSocket = std::make_shared<WebSocket>();
+	mWebSocket->onOpen([this, done = std::move(done)]() { prepareWebSocket(done); });
+	mWebSocket->open("ws://localhost/echo");
+}
+
+void Bench::next() {
+	for (auto &receiver : mActiveReceivers) {
+		receiver->onMessage(nullptr);
+		receiver->onMessageBuffer(nullptr);
+	}
+
+	mActiveSenders.clear();
+	mActiveReceivers.clear();
+	if (mDedicatedSender) {
+		mDedicatedSender->close();
+		mDedicatedSender.reset();
+		mDedicatedReceiver.reset();
+		mDedicatedLabel.clear();
+	}
+
+	if (mScenarios.empty()) {
+		std::printf("]}\n");
+		std::fflush(stdout);
+		benchFinish(mFailures);
+		mWebSocket.reset();
+		mSenders.clear();
+		mReceivers.clear();
+		mPc1.reset();
+		mPc2.reset();
+		std::free(mBallast);
+		mBallast = nullptr;
+		return;
+	}
+
+	mScenario = mScenarios.front();
+	mScenarios.pop_front();
+
+	if (mScenario.large && !mBallast) {
+		if (size_t ballast = size_t(std::max(benchGetBallast(), 0)) * 1024 * 1024)
+			mBallast = std::malloc(ballast);
+	}
+
+	if (mScenario.transport == Transport::WebSocket)
+		prepareWebSocket([this]() { start(); });
+	else
+		prepareChannels([this]() { start(); });
+}
+
+void Bench::start() {
+	const Scenario &s = mScenario;
+	for (auto &receiver : mActiveReceivers) {
+		if (s.buffers)
+			receiver->onMessageBuffer([this](MessageBuffer data) {
+				received(data.data(), data.size(), data.isString());
+			});
+		else
+			receiver->onMessage([this](message_variant data) {
+				if (auto *b = std::get_if<binary>(&data))
+					received(b->data(), b->size(), false);
+				else
+					received(reinterpret_cast<const byte *>(std::get<string>(data).data()),
+					         std::get<string>(data).size(), true);
+			});
+	}
+
+	// Binary messages carry their send time to measure latency
+	mText.assign(s.size, 'x');
+	mTextBuffer = MessageBuffer(mText);
+	mBinary.assign(std::max(s.size, sizeof(double)), byte(0x42));
+	if (s.large)
+		for (size_t i = 0; i < mBinary.size(); ++i)
+			mBinary[i] = byte(i % 251);
+
+	mWindow = std::clamp(MaxInFlight / std::max(s.size, size_t(1)), size_t(1), Window);
+	mLatencies.clear();
+	mLatencies.reserve(s.count);
+
+	mBroadcastTargets.clear();
+	if (s.broadcast)
+		for (auto &sender : mActiveSenders)
+			mBroadcastTargets.push_back(std::static_pointer_cast<DataChannel>(sender));
+
+	mSent = 0;
+	mReceived = 0;
+	mReceivedBytes = 0;
+	mFinished = false;
+	mCorrupted = false;
+	benchResetCounters();
+	mStartAllocations = allocations;
+	mSteadyAllocations = allocations;
+	mStartTime = emscripten_get_now();
+	mStartWallClock = benchWallClock();
+	pump();
+}
+
+void Bench::pump() {
+	const Scenario &s = mScenario;
+	while (s.broadcast && mSent < s.count && mSent - mReceived < mWindow) {
+		double now = emscripten_get_now();
+		std::memcpy(mBinary.data(), &now, sizeof(now));
+		auto results = broadcast(mBroadcastTargets, mBinary.data(), mBinary.size());
+		size_t sent = size_t(std::count(results.begin(), results.end(), true));
+		if (sent == 0)
+			break;
+
+		mSent += sent;
+	}
+
+	while (!s.broadcast && mSent < s.count && mSent - mReceived < mWindow) {
+		auto &sender = mActiveSenders[mSent % mActiveSenders.size()];
+		bool success;
+		if (s.text) {
+			// Sending a string copies it into a message_variant, unlike sending a buffer
+			success = s.buffers ? sender->send(mTextBuffer) : sender->send(mText);
+		} else {
+			double now = emscripten_get_now();
+			std::memcpy(mBinary.data(), &now, sizeof(now));
+			success = sender->send(mBinary.data(), mBinary.size());
+		}
+		if (!success)
+			break;
+
+		++mSent;
+	}
+
+	// Lossy channels might never deliver everything, so wait for the network to be idle
+	if (mSent == s.count && !mFinished)
+		poll();
+}
+
+void Bench::received(const byte *data, size_t size, bool isString) {
+	if (mFinished)
+		return;
+
+	++mReceived;
+	mReceivedBytes += size;
+	if (!isString) {
+		if (mScenario.large && !mCorrupted && !verify(data, size)) {
+			std::fprintf(stderr, "Corrupted %zu-byte payload received\n", size);
+			mCorrupted = true;
+			++mFailures;
+		}
+		if (size >= sizeof(double)) {
+			double sent;
+			std::memcpy(&sent, data, sizeof(sent));
+			mLatencies.push_back(emscripten_get_now() - sent);
+		}
+	}
+
+	if (mReceived == WarmupCount)
+		mSteadyAllocations = allocations;
+
+	if (mReceived == mScenario.count)
+		finish();
+	else if (mSent - mReceived <= mWindow / 2)
+		pump();
+}
+
+bool Bench::verify(const byte *data, size_t size) const {
+	// The first bytes carry the send time, check the pattern at a stride and at the end
+	if (size != mBinary.size())
+		return false;
+
+	for (size_t i = sizeof(double); i < size; i += 4093)
+		if (data[i] != mBinary[i])
+			return false;
+
+	return data[size - 1] == mBinary.back();
+}
+
+void Bench::poll() {
+	emscripten_async_call(
+	    [](void *arg) {
+		    auto *bench = static_cast<Bench *>(arg);
+		    if (bench->mFinished)
+			    return;
+
+		    if (bench->mScenario.transport == Transport::DataChannel && benchNetworkIdle())
+			    bench->finish();
+		    else
+			    bench->poll();
+	    },
+	    this, 1);
+}
+
+void Bench::finish() {
+	if (mFinished)
+		return;
+
+	mFinished = true;
+	// The simulated network may run on virtual time, throughput is measured on the wall clock
+	double elapsed = (benchWallClock() - mStartWallClock) / 1000.0;
+	double simulated = (emscripten_get_now() - mStartTime) / 1000.0;
+	size_t cppAllocations = allocations - mStartAllocations;
+
+	Counters counters = {};
+	benchGetCounters(reinterpret_cast<double *>(&counters));
+
+	double latencyMean = 0, latencyP50 = 0, latencyP99 = 0;
+	if (!mLatencies.empty()) {
+		std::sort(mLatencies.begin(), mLatencies.end());
+		for (double latency : mLatencies)
+			latencyMean += latency;
+		latencyMean /= double(mLatencies.size());
+		latencyP50 = mLatencies[mLatencies.size() / 2];
+		latencyP99 = mLatencies[std::min(mLatencies.size() - 1, mLatencies.size() * 99 / 100)];
+	}
+
+	const Scenario &s = mScenario;
+	std::printf("%s{\"transport\":\"%s\",\"mode\":\"%s\",\"channels\":%zu,\"payload\":\"%s\","
+	            "\"size\":%zu,\"messages\":%zu,\"delivered\":%zu,\"seconds\":%.6f,"
+	            "\"simulated_seconds\":%.6f,"
+	            "\"messages_per_second\":%.1f,\"megabytes_per_second\":%.3f,"
+	            "\"latency_ms_mean\":%.3f,\"latency_ms_p50\":%.3f,\"latency_ms_p99\":%.3f,"
+	            "\"crossings_to_js\":%.0f,\"crossings_to_wasm\":%.0f,"
+	            "\"crossings_per_message\":%.3f,\"glue_mallocs\":%.0f,\"glue_frees\":%.0f,"
+	            "\"glue_objects\":%.0f,\"cpp_allocations\":%zu,\"gc_count\":%.0f,"
+	            "\"gc_pause_ms\":%.3f,\"buffer_address\":%zu}",
+	            mFirstResult ? "" : ",",
+	            s.transport == Transport::WebSocket ? "websocket" : "datachannel", s.mode,
+	            s.channels, s.text ? "text" : "binary", s.size, s.count, mReceived, elapsed, simulated,
+	            double(mReceived) / elapsed, double(mReceivedBytes) / (1024.0 * 1024.0) / elapsed,
+	            latencyMean, latencyP50, latencyP99, counters.toJs, counters.toWasm,
+	            (counters.toJs + counters.toWasm) / double(s.count), counters.malloc,
+	            counters.free, counters.objects, cppAllocations, counters.gcCount,
+	            counters.gcDuration, size_t(reinterpret_cast<uintptr_t>(mBinary.data())));
+	mFirstResult = false;
+
+	// Steady-state messaging must not allocate in the glue, except for the view required to copy
+	// each received binary payload to the heap
+	size_t allowedObjects = (s.text ? 0 : mReceived) + ObjectSlack;
+	if (counters.malloc > 0 || counters.objects > double(allowedObjects)) {
+		std::fprintf(stderr, "Glue allocations above limits: %.0f mallocs, %.0f objects (max %zu)\n",
+		             counters.malloc, counters.objects, allowedObjects);
+		++mFailures;
+	}
+
+	// Receiving buffers and sending bytes or buffers must not allocate in the library either
+	if (s.buffers && mReceived > WarmupCount && allocations != mSteadyAllocations) {
+		std::fprintf(stderr, "Library allocations in steady state: %zu over %zu messages\n",
+		             allocations - mSteadyAllocations, mReceived - WarmupCount);
+		++mFailures;
+	}
+
+	emscripten_async_call([](void *arg) { static_cast<Bench *>(arg)->next(); }, this, 0);
+}
+
+} // namespace
+
+int main() {
+	static Bench bench;
+	bench.run();
+#ifndef __EMSCRIPTEN__
+	// There is no browser event loop to return to, so run the native runtime until done
+	rtc::native::run();
+	return benchExitCode();
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Native counterpart of js/bench.js, to run the benchmark suite against the fake transport of
+// native builds and profile it with native tooling
+
+#include "rtc/native.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+rtc::native::Counters start;
+int exitCode = 0;
+
+} // namespace
+
+extern "C" {
+
+void benchResetCounters() { start = rtc::native::counters(); }
+
+void benchGetCounters(double *counters) {
+	// Same layout as the Counters of main.cpp, the native runtime neither allocates nor collects
+	auto current = rtc::native::counters();
+	std::memset(counters, 0, 7 * sizeof(double));
+	counters[0] = double(current.toTransport - start.toTransport);
+	counters[1] = double(current.toLibrary - start.toLibrary);
+}
+
+double benchWallClock() {
+	using namespace std::chrono;
+	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+int benchNetworkIdle() { return rtc::native::idle() ? 1 : 0; }
+
+char *benchGetNetworkConfig() {
+	const char config[] = "{\"native\":true}";
+	char *str = static_cast<char *>(std::malloc(sizeof(config)));
+	std::memcpy(str, config, sizeof(config));
+	return str;
+}
+
+int benchGetBallast() {
+	const char *ballast = std::getenv("DATACHANNEL_WASM_BENCH_BALLAST");
+	return ballast ? std::atoi(ballast) : 0;
+}
+
+void benchFinish(int failures) {
+	if (failures)
+		exitCode = 1;
+}
+
+int benchExitCode() { return exitCode; }
+}
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Stand-in for the Emscripten header in native builds, declaring the few functions used by the
+// library, which are implemented by the native runtime on a virtual clock
+
+#ifndef EMSCRIPTEN_H
+#define EMSCRIPTEN_H
+
+#define EMSCRIPTEN_KEEPALIVE __attribute__((used))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*em_arg_callback_func)(void *);
+
+double emscripten_get_now(void);
+void emscripten_async_call(em_arg_callback_func func, void *arg, int millis);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EMSCRIPTEN_H
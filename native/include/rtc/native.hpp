@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_NATIVE_H
+#define RTC_NATIVE_H
+
+#include <chrono>
+#include <cstdint>
+
+// Native builds replace the browser and the JS glue with an in-process fake transport. Peer
+// connections created in the same process connect to each other through signaling as usual, and
+// WebSockets connect to an echo server. Without a browser event loop, the application drives the
+// runtime itself.
+namespace rtc::native {
+
+// Run pending tasks until none is left, the virtual clock jumping forward to each timer
+void run();
+
+// Same as run() but only up to the given amount of virtual time, for instance with recurring
+// timers like heartbeats which leave tasks pending forever
+void runFor(std::chrono::milliseconds duration);
+
+// Run the tasks due at the current time, returning whether any task is still pending
+bool poll();
+
+// Calls between the library and the fake transport, standing for crossings to and from JS
+struct Counters {
+	uint64_t toTransport = 0;
+	uint64_t toLibrary = 0;
+};
+
+Counters counters();
+void resetCounters();
+
+// Whether messages are still in flight between channels
+bool idle();
+
+// Whether the fake transport is running, for instance to leave its allocations out of those of
+// the library, as they stand for JS objects in browsers
+bool inTransport();
+
+} // namespace rtc::native
+
+#endif // RTC_NATIVE_H
@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "runtime.hpp"
+
+#include <emscripten/emscripten.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <queue>
+#include <vector>
+
+extern "C" {
+void *rtcAllocMessageBuffer(size_t size);
+void rtcDispatchLog(int level, const char *message);
+}
+
+namespace rtc::native {
+
+namespace {
+
+struct Task {
+	double time;
+	uint64_t sequence;
+	std::function<void()> func;
+
+	bool operator>(const Task &other) const {
+		return time != other.time ? time > other.time : sequence > other.sequence;
+	}
+};
+
+std::priority_queue<Task, std::vector<Task>, std::greater<Task>> tasks;
+uint64_t sequence = 0;
+double now = 0;
+size_t transfers = 0;
+Counters calls;
+bool transportRunning = false;
+std::optional<int> logLevel;
+
+} // namespace
+
+void run() {
+	while (!tasks.empty()) {
+		if (tasks.top().time > now)
+			now = tasks.top().time;
+
+		poll();
+	}
+}
+
+void runFor(std::chrono::milliseconds duration) {
+	double end = now + double(duration.count());
+	while (!tasks.empty() && tasks.top().time <= end) {
+		if (tasks.top().time > now)
+			now = tasks.top().time;
+
+		poll();
+	}
+	now = end;
+}
+
+bool poll() {
+	while (!tasks.empty() && tasks.top().time <= now) {
+		// Tasks may post other tasks, so pop before running
+		auto func = std::move(const_cast<Task &>(tasks.top()).func);
+		tasks.pop();
+		ExecutionScope scope(true);
+		func();
+	}
+	return !tasks.empty();
+}
+
+Counters counters() { return calls; }
+
+void resetCounters() { calls = {}; }
+
+bool idle() { return transfers == 0; }
+
+bool inTransport() { return transportRunning; }
+
+ExecutionScope::ExecutionScope(bool transport) : mPrevious(transportRunning) {
+	transportRunning = transport;
+}
+
+ExecutionScope::~ExecutionScope() { transportRunning = mPrevious; }
+
+void post(double delay, std::function<void()> task) {
+	tasks.push({now + std::max(delay, 0.0), sequence++, std::move(task)});
+}
+
+void beginTransfer() { ++transfers; }
+
+void endTransfer() { --transfers; }
+
+void log(int level, const char *message) {
+	// Messages go to the library logger once it has set a level, like in the JS glue
+	if (!logLevel) {
+		if (level <= 2)
+			std::fprintf(stderr, "%s\n", message);
+		return;
+	}
+	if (level > *logLevel)
+		return;
+
+	dispatch(rtcDispatchLog, level, message);
+}
+
+void setLogLevel(int level) { logLevel = level; }
+
+char *allocMessage(const char *data, size_t size, bool isString) {
+	char *buffer;
+	{
+		// Standing for a call into wasm, so allocations are the library's
+		ExecutionScope scope(false);
+		buffer = static_cast<char *>(rtcAllocMessageBuffer(isString ? size + 1 : size));
+	}
+	if (size > 0)
+		std::memcpy(buffer, data, size);
+	if (isString)
+		buffer[size] = '\0';
+	return buffer;
+}
+
+ExecutionScope enter() {
+	++calls.toTransport;
+	return ExecutionScope(true);
+}
+
+void countDispatch() { ++calls.toLibrary; }
+
+} // namespace rtc::native
+
+extern "C" {
+
+double emscripten_get_now(void) { return rtc::native::now; }
+
+void emscripten_async_call(em_arg_callback_func func, void *arg, int millis) {
+	rtc::native::post(millis, [func, arg]() {
+		rtc::native::ExecutionScope scope(false);
+		func(arg);
+	});
+}
+
+// Equivalents of the core JS libraries, without browser objects to send or download
+void rtcSetLogLevel(int level) {
+	auto scope = rtc::native::enter();
+	rtc::native::setLogLevel(level);
+}
+
+void rtcReleaseObject(int) { auto scope = rtc::native::enter(); }
+
+int rtcDownloadBuffer(const char *, size_t, const char *) {
+	auto scope = rtc::native::enter();
+	rtc::native::log(2, "Download is only available in browsers");
+	return 0;
+}
+}
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_NATIVE_RUNTIME_H
+#define RTC_NATIVE_RUNTIME_H
+
+#include "rtc/native.hpp"
+
+#include <cstddef>
+#include <functional>
+
+namespace rtc::native {
+
+// Schedule a task on the virtual clock, tasks due at the same time running in order
+void post(double delay, std::function<void()> task);
+
+// Messages in flight, for idle()
+void beginTransfer();
+void endTransfer();
+
+// Equivalent of the RTCLOG helper of the JS glue
+void log(int level, const char *message);
+void setLogLevel(int level);
+
+// Copy a payload to a buffer allocated for the library to adopt, null-terminating strings
+char *allocMessage(const char *data, size_t size, bool isString);
+
+// Code running on behalf of the transport or of the library, as allocations of the fake transport
+// stand for JS objects of the browser and must not be counted as the library's
+class ExecutionScope final {
+public:
+	explicit ExecutionScope(bool transport);
+	ExecutionScope(const ExecutionScope &other) = delete;
+	~ExecutionScope();
+
+	ExecutionScope &operator=(const ExecutionScope &other) = delete;
+
+private:
+	bool mPrevious;
+};
+
+// Count a call from the library into the transport, which runs until the returned scope ends
+[[nodiscard]] ExecutionScope enter();
+
+// Call a dispatch entry point of the library
+void countDispatch();
+
+template <typename F, typename... Args> void dispatch(F func, Args... args) {
+	countDispatch();
+	ExecutionScope scope(false);
+	func(args...);
+}
+
+} // namespace rtc::native
+
+#endif // RTC_NATIVE_RUNTIME_H
@@ -0,0 +1,570 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Fake of the WebRTC JS glue. Peer connections exchange descriptions naming their id, connect once
+// the answer is applied, and deliver messages between paired data channels on the next tick.
+
+#include "runtime.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+void rtcDispatchDataChannel(int pc, int dc, void *ptr);
+void rtcDispatchLocalDescription(int pc, const char *sdp, const char *type, void *ptr);
+void rtcDispatchLocalCandidate(int pc, const char *candidate, const char *mid, void *ptr);
+void rtcDispatchStateChange(int pc, int state, void *ptr);
+void rtcDispatchIceStateChange(int pc, int state, void *ptr);
+void rtcDispatchGatheringStateChange(int pc, int state, void *ptr);
+void rtcDispatchSignalingStateChange(int pc, int state, void *ptr);
+void rtcDispatchOpen(int dc, void *ptr);
+void rtcDispatchError(int dc, const char *error, void *ptr);
+void rtcDispatchMessage(int dc, char *data, ptrdiff_t size, void *ptr);
+void rtcDispatchBufferedAmountLow(int dc, void *ptr);
+void rtcDispatchForwardedSend(int dc, size_t size, ptrdiff_t bufferedAmount, void *ptr);
+}
+
+namespace rtc::native {
+
+namespace {
+
+enum class ReadyState { Connecting, Open, Closed };
+
+struct ForwardingRule {
+	int id;
+	std::vector<int> targets;
+	int type;
+	bool deliver;
+};
+
+struct FakeDataChannel {
+	int pc = 0;
+	std::string label;
+	bool unordered = false;
+	int maxRetransmits = -1;
+	int maxPacketLifeTime = -1;
+	int priority = 1;
+	int stream = -1; // Negative unless negotiated
+	void *user = nullptr;
+	int peer = 0;
+	ReadyState state = ReadyState::Connecting;
+	size_t bufferedAmount = 0;
+	size_t threshold = 0;
+	std::vector<ForwardingRule> rules;
+	int sendAccounting = 0;
+	std::array<double, 3 + 16> forwardedMetrics = {};
+};
+
+struct FakePeerConnection {
+	void *user = nullptr;
+	int peer = 0;
+	bool negotiating = false;
+	bool connected = false;
+	std::string localSdp, localType;
+	std::string remoteSdp, remoteType;
+	std::vector<int> channels;
+};
+
+std::unordered_map<int, FakePeerConnection> peerConnections;
+std::unordered_map<int, FakeDataChannel> dataChannels;
+int nextId = 1;
+
+const char *const PeerAttribute = "a=x-native-pc:";
+
+FakePeerConnection *findPeerConnection(int pc) {
+	auto it = peerConnections.find(pc);
+	return it != peerConnections.end() ? &it->second : nullptr;
+}
+
+FakeDataChannel *findDataChannel(int dc) {
+	auto it = dataChannels.find(dc);
+	return it != dataChannels.end() ? &it->second : nullptr;
+}
+
+char *duplicate(const std::string &str) {
+	// Freed by the library
+	char *copy = static_cast<char *>(std::malloc(str.size() + 1));
+	std::memcpy(copy, str.c_str(), str.size() + 1);
+	return copy;
+}
+
+void setLocalDescription(int pc, const char *type) {
+	FakePeerConnection *p = findPeerConnection(pc);
+	if (!p)
+		return;
+
+	p->localSdp = "v=0\r\no=- " + std::to_string(pc) + " 0 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\n" +
+	              PeerAttribute + std::to_string(pc) + "\r\n";
+	p->localType = type;
+	if (p->user) {
+		dispatch(rtcDispatchGatheringStateChange, pc, 1, p->user);
+		dispatch(rtcDispatchLocalDescription, pc, p->localSdp.c_str(), p->localType.c_str(),
+		         p->user);
+		dispatch(rtcDispatchSignalingStateChange, pc, p->localType == "offer" ? 1 : 0, p->user);
+	}
+
+	post(0, [pc]() {
+		FakePeerConnection *p = findPeerConnection(pc);
+		if (!p || !p->user)
+			return;
+
+		auto candidate = "candidate:1 1 udp 2122260223 127.0.0.1 " + std::to_string(10000 + pc) +
+		                 " typ host";
+		dispatch(rtcDispatchLocalCandidate, pc, candidate.c_str(), "0", p->user);
+		dispatch(rtcDispatchGatheringStateChange, pc, 2, p->user);
+	});
+}
+
+void openChannel(int dc) {
+	FakeDataChannel *d = findDataChannel(dc);
+	if (!d || d->state != ReadyState::Connecting)
+		return;
+
+	d->state = ReadyState::Open;
+	if (d->user)
+		dispatch(rtcDispatchOpen, dc, d->user);
+}
+
+void pairChannel(int dc) {
+	FakeDataChannel *d = findDataChannel(dc);
+	FakePeerConnection *p = d ? findPeerConnection(d->pc) : nullptr;
+	FakePeerConnection *remote = p ? findPeerConnection(p->peer) : nullptr;
+	if (!remote || d->peer)
+		return;
+
+	if (d->stream >= 0) {
+		// Negotiated channels pair with the remote channel of the same id once it exists
+		for (int rdc : remote->channels) {
+			FakeDataChannel *r = findDataChannel(rdc);
+			if (r && r->stream == d->stream && !r->peer) {
+				r->peer = dc;
+				d->peer = rdc;
+				openChannel(rdc);
+				openChannel(dc);
+				return;
+			}
+		}
+		return;
+	}
+
+	int rdc = nextId++;
+	FakeDataChannel &r = dataChannels[rdc];
+	r = *d;
+	r.pc = p->peer;
+	r.user = nullptr;
+	r.peer = dc;
+	r.state = ReadyState::Open;
+	r.bufferedAmount = 0;
+	r.threshold = 0;
+	r.rules.clear();
+	r.sendAccounting = 0;
+	r.forwardedMetrics = {};
+	remote->channels.push_back(rdc);
+	d->peer = rdc;
+
+	// The library sets its user pointer on the received channel, which then dispatches open
+	if (remote->user)
+		dispatch(rtcDispatchDataChannel, r.pc, rdc, remote->user);
+
+	openChannel(dc);
+}
+
+void setStates(int pc, int state, int iceState) {
+	FakePeerConnection *p = findPeerConnection(pc);
+	if (!p || !p->user)
+		return;
+
+	dispatch(rtcDispatchIceStateChange, pc, iceState, p->user);
+	dispatch(rtcDispatchStateChange, pc, state, p->user);
+}
+
+void connect(int pc) {
+	FakePeerConnection *p = findPeerConnection(pc);
+	if (!p || !findPeerConnection(p->peer))
+		return;
+
+	int peer = p->peer;
+	p->connected = true;
+	findPeerConnection(peer)->connected = true;
+	setStates(pc, 1, 1);
+	setStates(peer, 1, 1);
+	post(1, [pc, peer]() {
+		setStates(pc, 2, 2);
+		setStates(peer, 2, 2);
+		for (int id : {pc, peer})
+			if (FakePeerConnection *p = findPeerConnection(id))
+				for (int dc : std::vector<int>(p->channels))
+					pairChannel(dc);
+	});
+}
+
+void closeChannel(int dc) {
+	FakeDataChannel *d = findDataChannel(dc);
+	if (!d)
+		return;
+
+	d->state = ReadyState::Closed;
+	int peer = d->peer;
+	dataChannels.erase(dc);
+	post(0, [peer]() {
+		FakeDataChannel *r = findDataChannel(peer);
+		if (!r || r->state == ReadyState::Closed)
+			return;
+
+		r->state = ReadyState::Closed;
+		r->peer = 0;
+		if (r->user)
+			dispatch(rtcDispatchMessage, peer, static_cast<char *>(nullptr), ptrdiff_t(0), r->user);
+	});
+}
+
+bool forwardMessage(FakeDataChannel &d, const std::string &payload, bool isString);
+
+ptrdiff_t sendMessage(int dc, const char *data, size_t size, bool isString) {
+	FakeDataChannel *d = findDataChannel(dc);
+	if (!d || d->state != ReadyState::Open)
+		return -1;
+
+	// The payload is copied synchronously, as send() does in browsers
+	d->bufferedAmount += size;
+	beginTransfer();
+	post(0, [dc, peer = d->peer, payload = std::string(data, size), isString]() {
+		endTransfer();
+		if (FakeDataChannel *d = findDataChannel(dc)) {
+			size_t before = d->bufferedAmount;
+			d->bufferedAmount -= payload.size();
+			if (before > d->threshold && d->bufferedAmount <= d->threshold && d->user)
+				dispatch(rtcDispatchBufferedAmountLow, dc, d->user);
+		}
+
+		FakeDataChannel *r = findDataChannel(peer);
+		if (!r || r->state != ReadyState::Open)
+			return;
+		if (!forwardMessage(*r, payload, isString) || !r->user)
+			return;
+
+		char *buffer = allocMessage(payload.data(), payload.size(), isString);
+		dispatch(rtcDispatchMessage, peer, buffer,
+		         isString ? -ptrdiff_t(payload.size() + 1) : ptrdiff_t(payload.size()), r->user);
+	});
+	return ptrdiff_t(d->bufferedAmount);
+}
+
+void accountForwardedSend(int dc, size_t size, ptrdiff_t bufferedAmount) {
+	FakeDataChannel *d = findDataChannel(dc);
+	if (!d)
+		return;
+
+	if (d->sendAccounting == 1) {
+		auto &metrics = d->forwardedMetrics;
+		metrics[0] += 1;
+		metrics[1] += double(size);
+		metrics[2] = std::max(metrics[2], double(bufferedAmount));
+		size_t bucket = 0;
+		for (size_t limit = 16; size > limit && bucket < 15; limit <<= 1)
+			++bucket;
+		metrics[3 + bucket] += 1;
+	} else if (d->sendAccounting == 2 && d->user) {
+		dispatch(rtcDispatchForwardedSend, dc, size, bufferedAmount, d->user);
+	}
+}
+
+bool forwardMessage(FakeDataChannel &d, const std::string &payload, bool isString) {
+	if (d.rules.empty())
+		return true;
+
+	int type = !isString && !payload.empty() ? int(uint8_t(payload[0])) : -1;
+	bool matched = false;
+	bool deliver = false;
+	auto rules = d.rules;
+	for (const ForwardingRule &rule : rules) {
+		if (rule.type >= 0 && rule.type != type)
+			continue;
+
+		matched = true;
+		deliver = deliver || rule.deliver;
+		for (int target : rule.targets) {
+			ptrdiff_t result = sendMessage(target, payload.data(), payload.size(), isString);
+			if (result >= 0)
+				accountForwardedSend(target, payload.size(), result);
+		}
+	}
+	return !matched || deliver;
+}
+
+} // namespace
+
+} // namespace rtc::native
+
+using namespace rtc::native;
+
+extern "C" {
+
+int webrtcCreatePeerConnection(const char **, const char **, const char **, int, bool) {
+	auto scope = enter();
+	int pc = nextId++;
+	peerConnections[pc];
+	return pc;
+}
+
+void webrtcDeletePeerConnection(int pc) {
+	auto scope = enter();
+	FakePeerConnection *p = findPeerConnection(pc);
+	if (!p)
+		return;
+
+	for (int dc : p->channels)
+		closeChannel(dc);
+
+	peerConnections.erase(pc);
+}
+
+char *webrtcGetLocalDescription(int pc) {
+	auto scope = enter();
+	FakePeerConnection *p = findPeerConnection(pc);
+	return p && !p->localSdp.empty() ? duplicate(p->localSdp) : nullptr;
+}
+
+char *webrtcGetLocalDescriptionType(int pc) {
+	auto scope = enter();
+	FakePeerConnection *p = findPeerConnection(pc);
+	return p && !p->localType.empty() ? duplicate(p->localType) : nullptr;
+}
+
+char *webrtcGetRemoteDescription(int pc) {
+	auto scope = enter();
+	FakePeerConnection *p = findPeerConnection(pc);
+	return p && !p->remoteSdp.empty() ? duplicate(p->remoteSdp) : nullptr;
+}
+
+char *webrtcGetRemoteDescriptionType(int pc) {
+	auto scope = enter();
+	FakePeerConnection *p = findPeerConnection(pc);
+	return p && !p->remoteType.empty() ? duplicate(p->remoteType) : nullptr;
+}
+
+int webrtcCreateDataChannel(int pc, const char *label, bool unordered, int maxRetransmits,
+                            int maxPacketLifeTime, int priority, int id) {
+	auto scope = enter();
+	FakePeerConnection *p = findPeerConnection(pc);
+	if (!p)
+		return 0;
+
+	int dc = nextId++;
+	FakeDataChannel &d = dataChannels[dc];
+	d.pc = pc;
+	d.label = label;
+	d.unordered = unordered;
+	d.maxRetransmits = maxRetransmits;
+	d.maxPacketLifeTime = maxPacketLifeTime;
+	d.priority = priority;
+	d.stream = id;
+	p->channels.push_back(dc);
+	if (p->connected) {
+		post(0, [dc]() { pairChannel(dc); });
+	} else if (!p->negotiating) {
+		// Like negotiationneeded, the offer is created asynchronously
+		p->negotiating = true;
+		post(0, [pc]() { setLocalDescription(pc, "offer"); });
+	}
+	return dc;
+}
+
+void webrtcSetRemoteDescription(int pc, const char *sdp, const char *type) {
+	auto scope = enter();
+	FakePeerConnection *p = findPeerConnection(pc);
+	if (!p)
+		return;
+
+	p->remoteSdp = sdp;
+	p->remoteType = type;
+	auto pos = p->remoteSdp.find(PeerAttribute);
+	if (pos == std::string::npos) {
+		log(2, "Failed to set remote description: unknown peer");
+		return;
+	}
+
+	int peer = std::atoi(p->remoteSdp.c_str() + pos + std::strlen(PeerAttribute));
+	if (p->remoteType == "offer") {
+		p->peer = peer;
+		p->negotiating = true;
+		if (p->user)
+			dispatch(rtcDispatchSignalingStateChange, pc, 2, p->user);
+		post(0, [pc]() { setLocalDescription(pc, "answer"); });
+	} else if (p->remoteType == "answer") {
+		p->peer = peer;
+		if (FakePeerConnection *remote = findPeerConnection(peer))
+			remote->peer = pc;
+		if (p->user)
+			dispatch(rtcDispatchSignalingStateChange, pc, 0, p->user);
+		post(0, [pc]() { connect(pc); });
+	}
+}
+
+void webrtcAddRemoteCandidate(int, const char *, const char *) { auto scope = enter(); }
+
+int webrtcGetTimeline(int, double *, int) {
+	auto scope = enter();
+	return 0;
+}
+
+int webrtcGetTimelineLabel(int, int, char *, size_t) {
+	auto scope = enter();
+	return -1;
+}
+
+void webrtcSetUserPointer(int i, void *ptr) {
+	auto scope = enter();
+	if (FakePeerConnection *p = findPeerConnection(i))
+		p->user = ptr;
+
+	if (FakeDataChannel *d = findDataChannel(i)) {
+		d->user = ptr;
+		// The channel might already be open, for instance when received from the remote peer
+		if (d->state == ReadyState::Open)
+			post(0, [i]() {
+				FakeDataChannel *d = findDataChannel(i);
+				if (d && d->user && d->state == ReadyState::Open)
+					dispatch(rtcDispatchOpen, i, d->user);
+			});
+	}
+}
+
+void webrtcDeleteDataChannel(int dc) {
+	auto scope = enter();
+	FakeDataChannel *d = findDataChannel(dc);
+	if (!d)
+		return;
+
+	if (FakePeerConnection *p = findPeerConnection(d->pc)) {
+		auto &channels = p->channels;
+		channels.erase(std::remove(channels.begin(), channels.end(), dc), channels.end());
+	}
+	closeChannel(dc);
+}
+
+int webrtcGetDataChannelLabel(int dc, char *buffer, size_t size) {
+	auto scope = enter();
+	FakeDataChannel *d = findDataChannel(dc);
+	if (!d)
+		return 0;
+	if (size == 0)
+		return int(d->label.size());
+
+	size_t length = std::min(d->label.size(), size - 1);
+	std::memcpy(buffer, d->label.data(), length);
+	buffer[length] = '\0';
+	return int(d->label.size());
+}
+
+int webrtcGetDataChannelUnordered(int dc) {
+	auto scope = enter();
+	FakeDataChannel *d = findDataChannel(dc);
+	return d && d->unordered ? 1 : 0;
+}
+
+int webrtcGetDataChannelMaxPacketLifeTime(int dc) {
+	auto scope = enter();
+	FakeDataChannel *d = findDataChannel(dc);
+	return d ? d->maxPacketLifeTime : -1;
+}
+
+int webrtcGetDataChannelMaxRetransmits(int dc) {
+	auto scope = enter();
+	FakeDataChannel *d = findDataChannel(dc);
+	return d ? d->maxRetransmits : -1;
+}
+
+int webrtcGetDataChannelPriority(int dc) {
+	auto scope = enter();
+	FakeDataChannel *d = findDataChannel(dc);
+	return d ? d->priority : 1;
+}
+
+int webrtcAddForwardingRule(int dc, const int *targets, int count, int type, int deliver) {
+	auto scope = enter();
+	FakeDataChannel *d = findDataChannel(dc);
+	if (!d)
+		return 0;
+
+	int id = nextId++;
+	d->rules.push_back({id, std::vector<int>(targets, targets + count), type, deliver != 0});
+	return id;
+}
+
+void webrtcRemoveForwardingRule(int dc, int id) {
+	auto scope = enter();
+	if (FakeDataChannel *d = findDataChannel(dc)) {
+		auto &rules = d->rules;
+		rules.erase(std::remove_if(rules.begin(), rules.end(),
+		                           [id](const ForwardingRule &rule) { return rule.id == id; }),
+		            rules.end());
+	}
+}
+
+void webrtcSetSendAccounting(int dc, int mode) {
+	auto scope = enter();
+	if (FakeDataChannel *d = findDataChannel(dc))
+		d->sendAccounting = mode;
+}
+
+double webrtcGetForwardedMetric(int dc, int index) {
+	auto scope = enter();
+	FakeDataChannel *d = findDataChannel(dc);
+	return d ? d->forwardedMetrics[size_t(index)] : 0;
+}
+
+ptrdiff_t webrtcGetBufferedAmount(int dc) {
+	auto scope = enter();
+	FakeDataChannel *d = findDataChannel(dc);
+	return d ? ptrdiff_t(d->bufferedAmount) : 0;
+}
+
+void webrtcSetBufferedAmountLowThreshold(int dc, size_t threshold) {
+	auto scope = enter();
+	if (FakeDataChannel *d = findDataChannel(dc))
+		d->threshold = threshold;
+}
+
+ptrdiff_t webrtcSendMessage(int dc, const char *buffer, size_t size, int isString) {
+	auto scope = enter();
+	return sendMessage(dc, buffer, size, isString != 0);
+}
+
+void webrtcBroadcastMessage(const int *dcs, int count, const char *buffer, size_t size,
+                            int isString, ptrdiff_t *results) {
+	auto scope = enter();
+	for (int i = 0; i < count; ++i)
+		results[i] = sendMessage(dcs[i], buffer, size, isString != 0);
+}
+
+int webrtcSendObject(int, int, size_t, void *) {
+	auto scope = enter();
+	log(2, "Objects can only be sent in browsers");
+	return 0;
+}
+}
@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Fake of the WebSocket JS glue, connecting every WebSocket to an in-process echo server. Receiving
+// can be paused like with the WebSocketStream backend.
+
+#include "runtime.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+extern "C" {
+void wsDispatchOpen(int ws, void *ptr);
+void wsDispatchError(int ws, const char *error, void *ptr);
+void wsDispatchMessage(int ws, char *data, ptrdiff_t size, void *ptr);
+void wsDispatchBufferedAmountLow(int ws, void *ptr);
+}
+
+namespace rtc::native {
+
+namespace {
+
+enum class ReadyState { Connecting = 0, Open = 1, Closing = 2, Closed = 3 };
+
+struct FakeWebSocket {
+	std::string url;
+	void *user = nullptr;
+	ReadyState state = ReadyState::Connecting;
+	size_t bufferedAmount = 0;
+	size_t threshold = 0;
+	bool paused = false;
+	std::deque<std::pair<std::string, bool>> received;
+};
+
+std::unordered_map<int, FakeWebSocket> webSockets;
+int nextId = 1;
+
+FakeWebSocket *findWebSocket(int ws) {
+	auto it = webSockets.find(ws);
+	return it != webSockets.end() ? &it->second : nullptr;
+}
+
+void deliver(int ws) {
+	FakeWebSocket *w = findWebSocket(ws);
+	while (w && !w->paused && !w->received.empty()) {
+		auto [payload, isString] = std::move(w->received.front());
+		w->received.pop_front();
+		if (!w->user)
+			continue;
+
+		char *buffer = allocMessage(payload.data(), payload.size(), isString);
+		dispatch(wsDispatchMessage, ws, buffer,
+		         isString ? -ptrdiff_t(payload.size() + 1) : ptrdiff_t(payload.size()), w->user);
+
+		// The callback might have paused reception or deleted the WebSocket
+		w = findWebSocket(ws);
+	}
+}
+
+} // namespace
+
+} // namespace rtc::native
+
+using namespace rtc::native;
+
+extern "C" {
+
+int wsCreateWebSocket(const char *url) {
+	auto scope = enter();
+	int ws = nextId++;
+	webSockets[ws].url = url;
+	post(0, [ws]() {
+		FakeWebSocket *w = findWebSocket(ws);
+		if (!w || w->state != ReadyState::Connecting)
+			return;
+
+		w->state = ReadyState::Open;
+		if (w->user)
+			dispatch(wsDispatchOpen, ws, w->user);
+	});
+	return ws;
+}
+
+void wsDeleteWebSocket(int ws) {
+	auto scope = enter();
+	webSockets.erase(ws);
+}
+
+ptrdiff_t wsSendMessage(int ws, const char *buffer, size_t size, int isString) {
+	auto scope = enter();
+	FakeWebSocket *w = findWebSocket(ws);
+	if (!w || w->state != ReadyState::Open)
+		return -1;
+
+	w->bufferedAmount += size;
+	beginTransfer();
+	post(0, [ws, payload = std::string(buffer, size), isString = isString != 0]() {
+		endTransfer();
+		FakeWebSocket *w = findWebSocket(ws);
+		if (!w || w->state != ReadyState::Open)
+			return;
+
+		size_t before = w->bufferedAmount;
+		w->bufferedAmount -= payload.size();
+		if (before > w->threshold && w->bufferedAmount <= w->threshold && w->user)
+			dispatch(wsDispatchBufferedAmountLow, ws, w->user);
+
+		w = findWebSocket(ws);
+		if (!w)
+			return;
+
+		w->received.emplace_back(payload, isString);
+		deliver(ws);
+	});
+	return ptrdiff_t(w->bufferedAmount);
+}
+
+int wsSendObject(int, int, size_t, void *) {
+	auto scope = enter();
+	log(2, "Objects can only be sent in browsers");
+	return 0;
+}
+
+char *wsGetWebSocketUrl(int ws) {
+	auto scope = enter();
+	FakeWebSocket *w = findWebSocket(ws);
+	if (!w)
+		return nullptr;
+
+	// Freed by the library
+	char *url = static_cast<char *>(std::malloc(w->url.size() + 1));
+	std::memcpy(url, w->url.c_str(), w->url.size() + 1);
+	return url;
+}
+
+int wsGetWebSocketState(int ws) {
+	auto scope = enter();
+	FakeWebSocket *w = findWebSocket(ws);
+	return int(w ? w->state : ReadyState::Closed);
+}
+
+ptrdiff_t wsGetBufferedAmount(int ws) {
+	auto scope = enter();
+	FakeWebSocket *w = findWebSocket(ws);
+	return w ? ptrdiff_t(w->bufferedAmount) : 0;
+}
+
+void wsSetBufferedAmountLowThreshold(int ws, size_t threshold) {
+	auto scope = enter();
+	if (FakeWebSocket *w = findWebSocket(ws))
+		w->threshold = threshold;
+}
+
+void wsSetReceivePaused(int ws, int paused) {
+	auto scope = enter();
+	FakeWebSocket *w = findWebSocket(ws);
+	if (!w)
+		return;
+
+	w->paused = paused != 0;
+	if (!w->paused)
+		post(0, [ws]() { deliver(ws); });
+}
+
+int wsIsStreamBackend(int) {
+	auto scope = enter();
+	return 1;
+}
+
+void wsSetUserPointer(int ws, void *ptr) {
+	auto scope = enter();
+	FakeWebSocket *w = findWebSocket(ws);
+	if (!w)
+		return;
+
+	w->user = ptr;
+	if (w->state == ReadyState::Open)
+		post(0, [ws]() {
+			FakeWebSocket *w = findWebSocket(ws);
+			if (w && w->user && w->state == ReadyState::Open)
+				dispatch(wsDispatchOpen, ws, w->user);
+		});
+}
+}
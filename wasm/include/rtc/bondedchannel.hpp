@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_BONDEDCHANNEL_H
+#define RTC_BONDEDCHANNEL_H
+
+#include "channel.hpp"
+#include "common.hpp"
+#include "datachannel.hpp"
+#include "peerconnection.hpp"
+
+#include <bitset>
+#include <vector>
+
+namespace rtc {
+
+// One path of a bond, a data channel on its own peer connection to the same remote peer
+struct BondPath {
+	shared_ptr<PeerConnection> peerConnection;
+	shared_ptr<DataChannel> channel;
+};
+
+enum class BondMode {
+	Redundant, // Send every message on all paths, the first copy to arrive is delivered
+	Fastest    // Send every message on the path with the lowest heartbeat round-trip time
+};
+
+struct BondInit {
+	BondMode mode = BondMode::Redundant;
+
+	// In redundant mode, a path buffering more than this is skipped for as long as another path
+	// takes the message, so that a stalled path does not accumulate a backlog
+	size_t maxPathBufferedAmount = 1024 * 1024;
+};
+
+// Channel bonding paths to the same peer, for instance over Wi-Fi and cellular or through
+// different TURN servers, so that messages survive the loss of any single path. Both peers must
+// bond their paths, as messages are framed with a sequence number to drop duplicates on
+// reception. Messages are not reordered across paths.
+class BondedChannel final : public Channel {
+public:
+	explicit BondedChannel(std::vector<BondPath> paths, BondInit init = {});
+	BondedChannel(const BondedChannel &other) = delete;
+	BondedChannel(BondedChannel &&other) = delete;
+	~BondedChannel();
+
+	BondedChannel &operator=(const BondedChannel &other) = delete;
+	BondedChannel &operator=(BondedChannel &&other) = delete;
+
+	void close() override;
+	bool send(message_variant data) override;
+	bool send(const byte *data, size_t size) override;
+	bool send(const MessageBuffer &data) override;
+
+	bool isOpen() const override;
+	bool isClosed() const override;
+
+	// Amount buffered on the path which would deliver the next message first
+	size_t bufferedAmount() const override;
+
+	BondMode mode() const;
+	void setMode(BondMode mode);
+
+	// Index of the path currently used in fastest mode
+	optional<size_t> activePath() const;
+
+	void setBufferedAmountLowThreshold(size_t amount) override;
+
+private:
+	// Sequence numbers received within this distance of the highest one are deduplicated, older
+	// ones are dropped
+	static constexpr size_t ReceiveWindow = 1024;
+
+	static void TriggerOpen(void *arg);
+
+	bool sendFrame(const MessageBuffer &frame);
+	bool isUsable(size_t index) const;
+	optional<size_t> selectPath();
+	bool accept(uint32_t seq);
+
+	void triggerPathOpen();
+	void triggerPathClosed();
+	void triggerPathMessage(MessageBuffer frame);
+	void triggerPathBufferedAmountLow();
+
+	std::vector<BondPath> mPaths;
+	BondInit mInit;
+	optional<size_t> mActivePath;
+	uint32_t mNextSeq = 0;
+	optional<uint32_t> mHighestSeq;
+	std::bitset<ReceiveWindow> mReceived;
+	size_t mBufferedAmountLowThreshold = 0;
+	bool mOpen = false;
+	bool mClosed = false;
+	shared_ptr<BondedChannel *> mSelf; // Timers only hold a weak reference to it
+};
+
+} // namespace rtc
+
+#endif // RTC_BONDEDCHANNEL_H
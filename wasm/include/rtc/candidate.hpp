@@ -29,18 +29,58 @@ namespace rtc {
 
 class Candidate {
 public:
+	enum class Family { Unresolved, Ipv4, Ipv6 };
+	enum class Type { Unknown, Host, ServerReflexive, PeerReflexive, Relayed };
+	enum class TransportType { Unknown, Udp, TcpActive, TcpPassive, TcpSo, TcpUnknown };
+
 	Candidate(const string &candidate, const string &mid);
-	string candidate() const;
-	string mid() const;
+	const string &candidate() const;
+	const string &mid() const;
 	operator string() const;
 
+	// Fields are parsed on first access, malformed candidates having empty or zero values
+	string foundation() const;
+	uint32_t component() const;
+	TransportType transportType() const;
+	uint32_t priority() const;
+	optional<string> address() const;
+	optional<uint16_t> port() const;
+	Family family() const;
+	Type type() const;
+	optional<string> relatedAddress() const;
+	optional<uint16_t> relatedPort() const;
+
 private:
+	// Token positions in the candidate string, so that copies do not need reparsing
+	struct Span {
+		size_t pos = 0;
+		size_t len = 0;
+	};
+
+	struct Fields {
+		Span foundation;
+		uint32_t component = 0;
+		TransportType transportType = TransportType::Unknown;
+		uint32_t priority = 0;
+		Span address;
+		optional<uint16_t> port;
+		Type type = Type::Unknown;
+		Span relatedAddress;
+		optional<uint16_t> relatedPort;
+	};
+
+	const Fields &fields() const;
+	optional<string> substr(Span span) const;
+
 	string mCandidate;
 	string mMid;
+	mutable optional<Fields> mFields;
 };
 
 } // namespace rtc
 
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, const rtc::Candidate &candidate);
+#endif
 
 #endif // RTC_CANDIDATE_H
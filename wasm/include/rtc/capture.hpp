@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_CAPTURE_H
+#define RTC_CAPTURE_H
+
+#include "common.hpp"
+
+namespace rtc {
+
+struct CaptureInit {
+	bool payloads = false;             // Record payloads in addition to sizes
+	size_t maxSize = 16 * 1024 * 1024; // Recording stops once the capture reaches this size
+};
+
+// Recorder of timestamped send and receive events, shared by the channels attached to it with
+// Channel::setCapture(). The capture format is documented in bench/js/replay.js, which replays
+// it over the network simulator.
+class Capture final {
+public:
+	enum class Direction { Send, Receive };
+
+	explicit Capture(CaptureInit init = {});
+
+	// Register a channel label, returning the stream index to record events with
+	uint32_t addStream(const string &label);
+
+	void record(uint32_t stream, Direction direction, const byte *data, size_t size,
+	            bool isString);
+
+	const binary &data() const;
+	bool isFull() const;
+
+	// Discard recorded events, keeping registered streams
+	void clear();
+
+	// Offer the capture as a file download, only available in browsers
+	bool download(const string &filename) const;
+
+private:
+	void writeStream(const string &label);
+	void writeVarint(uint64_t value);
+
+	const CaptureInit mInit;
+	binary mData;
+	std::vector<string> mStreams;
+	double mLastTime = 0;
+	bool mFull = false;
+};
+
+} // namespace rtc
+
+#endif // RTC_CAPTURE_H
@@ -23,7 +23,10 @@
 #ifndef RTC_CHANNEL_H
 #define RTC_CHANNEL_H
 
+#include "capture.hpp"
 #include "common.hpp"
+#include "message.hpp"
+#include "metrics.hpp"
 
 #include <functional>
 
@@ -36,6 +39,7 @@ public:
 	virtual void close() = 0;
 	virtual bool send(message_variant data) = 0;
 	virtual bool send(const byte *data, size_t size) = 0;
+	virtual bool send(const MessageBuffer &data);
 
 	virtual bool isOpen() const = 0;
 	virtual bool isClosed() const = 0;
@@ -49,23 +53,94 @@ public:
 	               std::function<void(string data)> stringCallback);
 	void onBufferedAmountLow(std::function<void()> callback);
 
+	// Receive messages in buffers from the message allocator instead, without copying. Unlike
+	// onMessage(), which allocates a binary or string per message, small payloads stay inline.
+	void onMessageBuffer(std::function<void(MessageBuffer data)> callback);
+
 	virtual void setBufferedAmountLowThreshold(size_t amount);
 
+	// Returns an empty snapshot if metrics are disabled
+	virtual ChannelMetrics metrics() const;
+
+	// Record sent and received messages to the capture under the given label, or stop recording
+	// if capture is null
+	void setCapture(shared_ptr<Capture> capture, const string &label);
+
 protected:
 	virtual void triggerOpen();
 	virtual void triggerClosed();
 	virtual void triggerError(string error);
 	virtual void triggerMessage(message_variant data);
+	virtual void triggerMessageBuffer(MessageBuffer data);
 	virtual void triggerBufferedAmountLow();
 
+	// Metrics recording, result is the buffered amount after sending or negative on failure
+	void recordSend(size_t size, ptrdiff_t result) const;
+	void recordCrossing() const;
+	void recordBufferedAmount(size_t amount) const;
+	void recordReceive(size_t size) const;
+	void captureSend(const byte *data, size_t size, bool isString) const;
+	void captureReceive(const byte *data, size_t size, bool isString) const;
+
 private:
+	template <typename F> void timeDispatch(F &&dispatch) const;
+
 	std::function<void()> mOpenCallback;
 	std::function<void()> mClosedCallback;
 	std::function<void(string error)> mErrorCallback;
 	std::function<void(message_variant data)> mMessageCallback;
 	std::function<void()> mBufferedAmountLowCallback;
+	std::function<void(MessageBuffer data)> mMessageBufferCallback;
+	shared_ptr<Capture> mCapture;
+	uint32_t mCaptureStream = 0;
+
+#if RTC_ENABLE_METRICS
+	mutable ChannelMetrics mMetrics;
+#endif
 };
 
+#if RTC_ENABLE_METRICS
+inline void Channel::recordSend(size_t size, ptrdiff_t result) const {
+	++mMetrics.crossings;
+	if (result < 0) {
+		++mMetrics.sendFailures;
+		return;
+	}
+	++mMetrics.messagesSent;
+	mMetrics.bytesSent += size;
+	++mMetrics.sentSizes[ChannelMetrics::HistogramBucket(size)];
+	recordBufferedAmount(size_t(result));
+}
+
+inline void Channel::recordCrossing() const { ++mMetrics.crossings; }
+
+inline void Channel::recordBufferedAmount(size_t amount) const {
+	if (amount > mMetrics.peakBufferedAmount)
+		mMetrics.peakBufferedAmount = amount;
+}
+
+inline void Channel::recordReceive(size_t size) const {
+	++mMetrics.messagesReceived;
+	mMetrics.bytesReceived += size;
+	++mMetrics.receivedSizes[ChannelMetrics::HistogramBucket(size)];
+}
+#else
+inline void Channel::recordSend(size_t, ptrdiff_t) const {}
+inline void Channel::recordCrossing() const {}
+inline void Channel::recordBufferedAmount(size_t) const {}
+inline void Channel::recordReceive(size_t) const {}
+#endif
+
+inline void Channel::captureSend(const byte *data, size_t size, bool isString) const {
+	if (mCapture)
+		mCapture->record(mCaptureStream, Capture::Direction::Send, data, size, isString);
+}
+
+inline void Channel::captureReceive(const byte *data, size_t size, bool isString) const {
+	if (mCapture)
+		mCapture->record(mCaptureStream, Capture::Direction::Receive, data, size, isString);
+}
+
 } // namespace rtc
 
 #endif // RTC_CHANNEL_H
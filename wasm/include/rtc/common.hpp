@@ -25,7 +25,6 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <iostream>
 #include <memory>
 #include <optional>
 #include <stdexcept>
@@ -33,6 +32,10 @@
 #include <variant>
 #include <vector>
 
+#ifndef RTC_NO_IOSTREAM
+#include <iostream>
+#endif
+
 namespace rtc {
 
 using std::byte;
@@ -58,6 +61,13 @@ template <class... Ts> struct overloaded : Ts... {
 };
 template <class... Ts> overloaded(Ts...) -> overloaded<Ts...>;
 
+namespace impl {
+
+// Receives the events of the JS glue on behalf of the classes
+struct Dispatch;
+
+} // namespace impl
+
 } // namespace rtc
 
 #endif // RTC_COMMON_H
@@ -57,6 +57,9 @@ struct IceServer {
 
 struct Configuration {
 	std::vector<IceServer> iceServers;
+
+	// Mirror the connection setup timeline as performance marks visible in browser profiles
+	bool enableTimelineMarks = false;
 };
 
 } // namespace rtc
@@ -25,10 +25,26 @@
 
 #include "channel.hpp"
 #include "common.hpp"
+#include "object.hpp"
 #include "reliability.hpp"
 
+#include <deque>
+
 namespace rtc {
 
+class DataChannel;
+class PeerConnection;
+class SendScheduler;
+
+// Mirrors RTCPriorityType
+enum class Priority : int { VeryLow = 0, Low = 1, Medium = 2, High = 3 };
+
+struct ForwardingRule {
+	std::vector<shared_ptr<DataChannel>> targets;
+	optional<uint8_t> type; // Only forward binary messages starting with this byte
+	bool deliver = false;   // Also deliver forwarded messages to this channel
+};
+
 class DataChannel final : public Channel {
 public:
 	explicit DataChannel(int id);
@@ -37,28 +53,83 @@ public:
 	void close() override;
 	bool send(message_variant data) override;
 	bool send(const byte *data, size_t size) override;
+	bool send(const MessageBuffer &data) override;
+
+	// Stream a registered JS object in chunks without copying it to the wasm heap. Chunks are
+	// sent as binary messages and bypass any send scheduler.
+	bool sendObject(ObjectHandle object, TransferInit init = {});
+
+	// Latest-value sends for state updates: while the channel is backed up, the message replaces
+	// any message with the same key which has not been handed to the browser yet. Without a send
+	// scheduler, the channel is backed up when its buffered amount is above the low threshold,
+	// and latest-value messages may then be overtaken by regular ones.
+	bool sendLatest(uint32_t key, message_variant data);
+	bool sendLatest(uint32_t key, const byte *data, size_t size);
+
+	// Relay messages received on this channel to other channels directly in JS, without entering
+	// wasm. Messages matching no rule are delivered as usual. Forwarded messages bypass the send
+	// scheduler queue of their targets, but they are reported back to targets with a scheduler so
+	// that they count towards it. Metrics of targets include them without entering wasm.
+	int addForwardingRule(const ForwardingRule &rule);
+	void removeForwardingRule(int rule);
 
 	bool isOpen() const override;
 	bool isClosed() const override;
 	size_t bufferedAmount() const override;
+	ChannelMetrics metrics() const override;
 	string label() const;
 	Reliability reliability() const;
+	Priority priority() const;
 
 	void setBufferedAmountLowThreshold(size_t amount) override;
 
 private:
 	void triggerOpen() override;
+	void triggerBufferedAmountLow() override;
+
+	static std::vector<bool> transmit(const std::vector<shared_ptr<DataChannel>> &channels,
+	                                  const char *data, size_t size, bool isString);
+	bool transmit(const char *data, size_t size, bool isString);
+	bool transmitLatest(uint32_t key, const char *data, size_t size, bool isString);
+	void flushLatest();
+	bool sendNow(const char *data, size_t size, bool isString);
+	bool completeSend(size_t size, ptrdiff_t result);
+	void attachScheduler(shared_ptr<SendScheduler> scheduler, unsigned int weight);
+	void updateSendAccounting();
+	ChannelMetrics forwardedMetrics() const;
+	void setLowThreshold(size_t amount);
 
 	int mId;
 	string mLabel;
 	bool mConnected;
+	shared_ptr<SendScheduler> mScheduler;
+	size_t mBufferedAmountLowThreshold = 0;
+	size_t mLastBufferedAmount = 0;
+	std::deque<std::pair<uint32_t, MessageBuffer>> mLatest;
+	size_t mLatestAmount = 0;
+
+#if RTC_ENABLE_METRICS
+	ChannelMetrics mForwardedMetrics; // Kept when the channel is deleted in JS
+#endif
 
-	static void OpenCallback(void *ptr);
-	static void ErrorCallback(const char *error, void *ptr);
-	static void MessageCallback(const char *data, int size, void *ptr);
-	static void BufferedAmountLowCallback(void *ptr);
+	friend class PeerConnection;
+	friend class SendScheduler;
+
+	friend std::vector<bool> broadcast(const std::vector<shared_ptr<DataChannel>> &channels,
+	                                   message_variant data);
+	friend std::vector<bool> broadcast(const std::vector<shared_ptr<DataChannel>> &channels,
+	                                   const byte *data, size_t size);
+
+	friend struct impl::Dispatch;
 };
 
+// Send the same message to several data channels with a single call to the browser API, the
+// payload being materialized once and shared by all channels. Results are in channel order.
+std::vector<bool> broadcast(const std::vector<shared_ptr<DataChannel>> &channels,
+                            message_variant data);
+std::vector<bool> broadcast(const std::vector<shared_ptr<DataChannel>> &channels,
+                            const byte *data, size_t size);
+
 } // namespace rtc
 
 #endif // RTC_DATACHANNEL_H
@@ -49,7 +49,9 @@ private:
 
 } // namespace rtc
 
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, const rtc::Description &description);
 std::ostream &operator<<(std::ostream &out, rtc::Description::Type type);
+#endif
 
 #endif // RTC_DESCRIPTION_H
@@ -26,7 +26,6 @@
 #include "common.hpp"
 
 #include <future>
-#include <iostream>
 
 namespace rtc {
 
@@ -42,12 +41,16 @@ enum class LogLevel {
 
 typedef std::function<void(LogLevel level, string message)> LogCallback;
 
-// Dummy function for compatibility with libdatachannel
+// Without a callback, messages are written to stderr
 void InitLogger(LogLevel level, LogCallback callback = nullptr);
+
+// Dummy functions for compatibility with libdatachannel
 void Preload();
 std::shared_future<void> Cleanup();
 
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, LogLevel level);
+#endif
 
 } // namespace rtc
 
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_MESSAGE_H
+#define RTC_MESSAGE_H
+
+#include "common.hpp"
+
+#include <functional>
+
+namespace rtc {
+
+// Allocator for message payloads. The default one recycles blocks from slabs per power-of-two
+// size class, so that steady-state traffic does not hit malloc.
+struct MessageAllocator {
+	std::function<void *(size_t size)> allocate;
+	std::function<void(void *ptr, size_t size)> deallocate;
+};
+
+// Passing an empty allocator restores the default one. This must be called before any message
+// buffer is allocated, as buffers are released with the allocator current at that time.
+void SetMessageAllocator(MessageAllocator allocator);
+
+// Owning payload buffer, stored inline when small and allocated with the message allocator
+// otherwise. String payloads are always followed by a null character.
+class MessageBuffer final {
+public:
+	enum class Type { Binary, String };
+
+	static constexpr size_t InlineSize = 64;
+
+	MessageBuffer() = default;
+	explicit MessageBuffer(size_t size, Type type = Type::Binary);
+	MessageBuffer(const byte *data, size_t size, Type type = Type::Binary);
+	explicit MessageBuffer(const string &str);
+	MessageBuffer(const message_variant &message);
+	MessageBuffer(MessageBuffer &&other) noexcept;
+	MessageBuffer(const MessageBuffer &other) = delete;
+	~MessageBuffer();
+
+	MessageBuffer &operator=(MessageBuffer &&other) noexcept;
+	MessageBuffer &operator=(const MessageBuffer &other) = delete;
+
+	// Take ownership of size bytes in a block of capacity bytes from the message allocator,
+	// or copy them inline if they were written to the scratch area handed out to the glue
+	static MessageBuffer Adopt(byte *data, size_t size, size_t capacity, Type type);
+
+	byte *data() { return mData; }
+	const byte *data() const { return mData; }
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+	Type type() const { return mType; }
+	bool isString() const { return mType == Type::String; }
+	bool isInline() const { return mData == mInline; }
+
+	// Copy the payload out for the message_variant API
+	message_variant toVariant() const;
+
+private:
+	void allocate(size_t size, Type type);
+	void release();
+
+	byte *mData = nullptr;
+	size_t mSize = 0;
+	size_t mCapacity = 0;
+	Type mType = Type::Binary;
+	alignas(std::max_align_t) byte mInline[InlineSize];
+};
+
+} // namespace rtc
+
+#endif // RTC_MESSAGE_H
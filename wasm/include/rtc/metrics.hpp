@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_METRICS_H
+#define RTC_METRICS_H
+
+#include "common.hpp"
+
+#include <array>
+
+// Metrics are compiled out unless RTC_ENABLE_METRICS is set (see DATACHANNEL_WASM_METRICS)
+#ifndef RTC_ENABLE_METRICS
+#define RTC_ENABLE_METRICS 0
+#endif
+
+namespace rtc {
+
+struct ChannelMetrics {
+	// Message sizes are counted in power-of-two buckets: bucket 0 is up to 16 bytes,
+	// bucket i is up to 16 << i bytes, and the last bucket holds everything larger.
+	static const size_t HistogramSize = 16;
+	static size_t HistogramBucket(size_t size);
+
+	uint64_t messagesSent = 0;
+	uint64_t bytesSent = 0;
+	uint64_t sendFailures = 0;
+	uint64_t messagesReceived = 0;
+	uint64_t bytesReceived = 0;
+
+	// Calls between wasm and the JS glue made on behalf of the channel
+	uint64_t crossings = 0;
+
+	// Highest buffered amount observed after a send
+	size_t peakBufferedAmount = 0;
+
+	std::array<uint64_t, HistogramSize> sentSizes = {};
+	std::array<uint64_t, HistogramSize> receivedSizes = {};
+
+	// Time spent in the message callback, in milliseconds
+	double dispatchTime = 0;
+	double maxDispatchTime = 0;
+};
+
+} // namespace rtc
+
+#endif // RTC_METRICS_H
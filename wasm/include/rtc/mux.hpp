@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_MUX_H
+#define RTC_MUX_H
+
+#include "channel.hpp"
+#include "common.hpp"
+
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+namespace rtc {
+
+class Mux;
+
+struct MuxInit {
+	// Amount of data the mux lets the underlying channel buffer before queueing sends
+	size_t maxBufferedAmount = 256 * 1024;
+
+	// Bytes a stream of weight 1 may send per scheduling round when streams are queued
+	size_t quantum = 4096;
+};
+
+// Lightweight logical stream multiplexed over a Channel, opening it costs nothing on the wire
+class MuxStream final : public Channel, public std::enable_shared_from_this<MuxStream> {
+public:
+	~MuxStream();
+
+	void close() override;
+	bool send(message_variant data) override;
+	bool send(const byte *data, size_t size) override;
+	bool send(const MessageBuffer &data) override;
+
+	bool isOpen() const override;
+	bool isClosed() const override;
+	size_t bufferedAmount() const override;
+
+	uint32_t id() const;
+	unsigned int weight() const;
+	void setWeight(unsigned int weight);
+
+	void setBufferedAmountLowThreshold(size_t amount) override;
+
+private:
+	MuxStream(Mux *mux, uint32_t id, unsigned int weight);
+
+	bool enqueue(MessageBuffer frame);
+
+	Mux *mMux;
+	uint32_t mId;
+	unsigned int mWeight;
+	std::deque<MessageBuffer> mQueue;
+	size_t mQueuedAmount = 0;
+	size_t mDeficit = 0;
+	bool mResuming = false; // Interrupted mid-round, the quantum was already granted
+	size_t mBufferedAmountLowThreshold = 0;
+
+	friend class Mux;
+};
+
+class Mux final {
+public:
+	explicit Mux(shared_ptr<Channel> channel, MuxInit init = {});
+	Mux(const Mux &other) = delete;
+	Mux(Mux &&other) = delete;
+	~Mux();
+
+	Mux &operator=(const Mux &other) = delete;
+	Mux &operator=(Mux &&other) = delete;
+
+	void close();
+	bool isOpen() const;
+	bool isClosed() const;
+
+	shared_ptr<MuxStream> openStream(uint32_t id, unsigned int weight = 1);
+	shared_ptr<Channel> channel() const;
+
+	void onStream(std::function<void(shared_ptr<MuxStream> stream)> callback);
+
+private:
+	static void TriggerStreamOpen(void *arg);
+
+	shared_ptr<MuxStream> createStream(uint32_t id, unsigned int weight);
+	bool schedule(shared_ptr<MuxStream> stream, MessageBuffer frame);
+	bool hasRoom(size_t size);
+	bool sendFrame(const MessageBuffer &frame);
+	void flush();
+	void detach(MuxStream *stream);
+
+	void triggerOpen();
+	void triggerClosed();
+	void triggerError(string error);
+	void triggerMessage(MessageBuffer frame);
+
+	shared_ptr<Channel> mChannel;
+	MuxInit mInit;
+	std::unordered_map<uint32_t, weak_ptr<MuxStream>> mStreams;
+	std::deque<shared_ptr<MuxStream>> mActive;
+	size_t mBufferedAmount = 0; // Estimate, see hasRoom()
+
+	std::function<void(shared_ptr<MuxStream> stream)> mStreamCallback;
+
+	friend class MuxStream;
+};
+
+} // namespace rtc
+
+#endif // RTC_MUX_H
@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_OBJECT_H
+#define RTC_OBJECT_H
+
+#include "common.hpp"
+
+#include <functional>
+
+namespace rtc {
+
+// Handle on a JS Blob, File, ArrayBuffer or typed array, obtained by calling
+// Module.rtcRegisterObject(object) from JS. Sending it with sendObject() on a DataChannel or a
+// WebSocket streams it in chunks on the JS side, so that it is never copied to the wasm heap.
+using ObjectHandle = int;
+
+// Release the JS object, pending transfers keep their own reference
+void ReleaseObject(ObjectHandle object);
+
+// Closing or destroying the channel stops the transfer, which then completes unsuccessfully
+// without reporting further progress
+struct TransferInit {
+	size_t chunkSize = 64 * 1024;
+	std::function<void(size_t sent, size_t total)> onProgress;
+	std::function<void(bool success)> onComplete;
+};
+
+} // namespace rtc
+
+#endif // RTC_OBJECT_H
@@ -30,14 +30,59 @@
 #include "description.hpp"
 #include "reliability.hpp"
 
+#include <chrono>
 #include <functional>
 #include <optional>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace rtc {
 
+class Heartbeat;
+
 struct DataChannelInit {
 	Reliability reliability = {};
+	Priority priority = Priority::Low;
+
+	// A negotiated channel is not announced to the remote peer, which must create it as well
+	// with the same id
+	bool negotiated = false;
+	optional<uint16_t> id;
+
+	// Weight for the send scheduler, derived from the priority if zero
+	unsigned int weight = 0;
+};
+
+struct SendSchedulerInit {
+	// Amount of data all channels together may buffer in the browser before sends are queued
+	size_t maxBufferedAmount = 256 * 1024;
+
+	// Bytes a channel of weight 1 may send per scheduling round when channels are queued
+	size_t quantum = 4096;
+};
+
+struct HeartbeatInit {
+	// Id of the negotiated heartbeat channel, the same on both peers
+	uint16_t id = 1023;
+
+	// The peer is unresponsive once nothing has been received from it for missThreshold intervals
+	std::chrono::milliseconds interval = std::chrono::milliseconds(100);
+	unsigned int missThreshold = 3;
+};
+
+struct CandidatePolicy {
+	// Candidates for which the filter returns false are dropped
+	std::function<bool(const Candidate &candidate)> filter;
+
+	// Candidates with a higher preference are delivered first. Local candidates are held for
+	// reorderWindow after the first one, or until gathering completes if sooner, so that trickling
+	// is delayed by at most the window. Remote ones are ordered within addRemoteCandidates().
+	std::function<int(const Candidate &candidate)> preference;
+	std::chrono::milliseconds reorderWindow = std::chrono::milliseconds(100);
+
+	bool local = true;  // Apply to candidates passed to onLocalCandidate
+	bool remote = true; // Apply to candidates added with addRemoteCandidate(s)
 };
 
 class PeerConnection final {
@@ -71,10 +116,29 @@ public:
 		HaveRemotePranswer = 4,
 	};
 
+	// Connection setup timestamps in milliseconds, on the clock of performance.now(). The glue
+	// records the first 256 events only, so later events of long sessions are missing.
+	struct Timeline {
+		optional<double> created;
+		optional<double> localDescription;
+		optional<double> firstLocalCandidate;
+		optional<double> lastLocalCandidate;
+		optional<double> remoteDescription;
+		std::vector<std::pair<State, double>> stateChanges;
+		std::vector<std::pair<IceState, double>> iceStateChanges;
+		std::vector<std::pair<GatheringState, double>> gatheringStateChanges;
+		std::vector<std::pair<string, double>> dataChannelOpens; // by label
+	};
+
 	PeerConnection();
 	PeerConnection(const Configuration &config);
+	PeerConnection(const PeerConnection &other) = delete;
+	PeerConnection(PeerConnection &&other) = delete;
 	~PeerConnection();
 
+	PeerConnection &operator=(const PeerConnection &other) = delete;
+	PeerConnection &operator=(PeerConnection &&other) = delete;
+
 	void close();
 
 	State state() const;
@@ -83,11 +147,30 @@ public:
 	SignalingState signalingState() const;
 	optional<Description> localDescription() const;
 	optional<Description> remoteDescription() const;
+	Timeline timeline() const;
 
 	shared_ptr<DataChannel> createDataChannel(const string &label, DataChannelInit init = {});
 
+	// Meter sends from data channels created or received afterwards by weight, so that bulk
+	// channels cannot fill the association ahead of interactive ones
+	void enableSendScheduler(SendSchedulerInit init = {});
+
+	// Drop or reorder trickled candidates, for instance to discard TCP or prefer relays
+	void setCandidatePolicy(CandidatePolicy policy);
+
+	// Exchange heartbeats on a negotiated unreliable channel to notice the peer going silent long
+	// before the ICE state changes. The remote peer must enable them too.
+	void enableHeartbeat(HeartbeatInit init = {});
+
+	// Latest round-trip time measured by the heartbeat
+	optional<std::chrono::microseconds> roundTripTime() const;
+
+	// Whether the heartbeat has heard from the peer recently, true without heartbeat
+	bool isPeerResponsive() const;
+
 	void setRemoteDescription(const Description &description);
 	void addRemoteCandidate(const Candidate &candidate);
+	void addRemoteCandidates(std::vector<Candidate> candidates);
 
 	void onDataChannel(std::function<void(shared_ptr<DataChannel>)> callback);
 	void onLocalDescription(std::function<void(const Description &description)> callback);
@@ -96,6 +179,9 @@ public:
 	void onIceStateChange(std::function<void(IceState state)> callback);
 	void onGatheringStateChange(std::function<void(GatheringState state)> callback);
 	void onSignalingStateChange(std::function<void(SignalingState state)> callback);
+	void onPeerUnresponsive(std::function<void()> callback);
+	void onPeerResponsive(std::function<void()> callback);
+	void onRoundTripTime(std::function<void(std::chrono::microseconds rtt)> callback);
 
 protected:
 	void triggerDataChannel(shared_ptr<DataChannel> dataChannel);
@@ -105,6 +191,9 @@ protected:
 	void triggerIceStateChange(IceState state);
 	void triggerGatheringStateChange(GatheringState state);
 	void triggerSignalingStateChange(SignalingState state);
+	void triggerPeerUnresponsive();
+	void triggerPeerResponsive();
+	void triggerRoundTripTime(std::chrono::microseconds rtt);
 
 	std::function<void(shared_ptr<DataChannel>)> mDataChannelCallback;
 	std::function<void(const Description &description)> mLocalDescriptionCallback;
@@ -113,27 +202,37 @@ protected:
 	std::function<void(IceState state)> mIceStateChangeCallback;
 	std::function<void(GatheringState state)> mGatheringStateChangeCallback;
 	std::function<void(SignalingState state)> mSignalingStateChangeCallback;
+	std::function<void()> mPeerUnresponsiveCallback;
+	std::function<void()> mPeerResponsiveCallback;
+	std::function<void(std::chrono::microseconds rtt)> mRoundTripTimeCallback;
 
 private:
+	static void FlushLocalCandidates(void *arg);
+	void applyCandidatePolicy(std::vector<Candidate> &candidates) const;
+	void flushLocalCandidates();
+	shared_ptr<DataChannel> openDataChannel(const string &label, const DataChannelInit &init);
+
 	int mId;
+	shared_ptr<SendScheduler> mScheduler;
+	shared_ptr<Heartbeat> mHeartbeat;
+	CandidatePolicy mCandidatePolicy;
+	std::vector<Candidate> mPendingLocalCandidates;
+	shared_ptr<PeerConnection *> mReorderWindow; // Set while local candidates are held
 	State mState = State::New;
 	IceState mIceState = IceState::New;
 	GatheringState mGatheringState = GatheringState::New;
 	SignalingState mSignalingState = SignalingState::Stable;
 
-	static void DataChannelCallback(int dc, void *ptr);
-	static void DescriptionCallback(const char *sdp, const char *type, void *ptr);
-	static void CandidateCallback(const char *candidate, const char *mid, void *ptr);
-	static void StateChangeCallback(int state, void *ptr);
-	static void IceStateChangeCallback(int state, void *ptr);
-	static void GatheringStateChangeCallback(int state, void *ptr);
-	static void SignalingStateChangeCallback(int state, void *ptr);
+	friend class Heartbeat;
+	friend struct impl::Dispatch;
 };
 
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, PeerConnection::State state);
 std::ostream &operator<<(std::ostream &out, PeerConnection::IceState state);
 std::ostream &operator<<(std::ostream &out, PeerConnection::GatheringState state);
 std::ostream &operator<<(std::ostream &out, PeerConnection::SignalingState state);
+#endif
 
 } // namespace rtc
 
@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_C_API
+#define RTC_C_API
+
+// C API compatible with the one of libdatachannel for the features available in browsers. It is
+// layered directly on the JS glue: handles are plain integers, callbacks are function pointers
+// called with the user pointer set with rtcSetUserPointer(), and strings are copied to buffers
+// provided by the caller.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTC_ERR_SUCCESS 0
+#define RTC_ERR_INVALID -1   // invalid argument
+#define RTC_ERR_FAILURE -2   // runtime error
+#define RTC_ERR_NOT_AVAIL -3 // element not available
+#define RTC_ERR_TOO_SMALL -4 // buffer too small
+
+typedef enum {
+	RTC_NEW = 0,
+	RTC_CONNECTING = 1,
+	RTC_CONNECTED = 2,
+	RTC_DISCONNECTED = 3,
+	RTC_FAILED = 4,
+	RTC_CLOSED = 5
+} rtcState;
+
+typedef enum {
+	RTC_ICE_NEW = 0,
+	RTC_ICE_CHECKING = 1,
+	RTC_ICE_CONNECTED = 2,
+	RTC_ICE_COMPLETED = 3,
+	RTC_ICE_FAILED = 4,
+	RTC_ICE_DISCONNECTED = 5,
+	RTC_ICE_CLOSED = 6
+} rtcIceState;
+
+typedef enum {
+	RTC_GATHERING_NEW = 0,
+	RTC_GATHERING_INPROGRESS = 1,
+	RTC_GATHERING_COMPLETE = 2
+} rtcGatheringState;
+
+typedef enum {
+	RTC_SIGNALING_STABLE = 0,
+	RTC_SIGNALING_HAVE_LOCAL_OFFER = 1,
+	RTC_SIGNALING_HAVE_REMOTE_OFFER = 2,
+	RTC_SIGNALING_HAVE_LOCAL_PRANSWER = 3,
+	RTC_SIGNALING_HAVE_REMOTE_PRANSWER = 4,
+} rtcSignalingState;
+
+typedef enum {
+	RTC_LOG_NONE = 0,
+	RTC_LOG_FATAL = 1,
+	RTC_LOG_ERROR = 2,
+	RTC_LOG_WARNING = 3,
+	RTC_LOG_INFO = 4,
+	RTC_LOG_DEBUG = 5,
+	RTC_LOG_VERBOSE = 6
+} rtcLogLevel;
+
+typedef enum {
+	RTC_CERTIFICATE_DEFAULT = 0,
+	RTC_CERTIFICATE_ECDSA = 1,
+	RTC_CERTIFICATE_RSA = 2,
+} rtcCertificateType;
+
+typedef enum {
+	RTC_TRANSPORT_POLICY_ALL = 0,
+	RTC_TRANSPORT_POLICY_RELAY = 1
+} rtcTransportPolicy;
+
+typedef void (*rtcLogCallbackFunc)(rtcLogLevel level, const char *message);
+typedef void (*rtcDescriptionCallbackFunc)(int pc, const char *sdp, const char *type, void *ptr);
+typedef void (*rtcCandidateCallbackFunc)(int pc, const char *cand, const char *mid, void *ptr);
+typedef void (*rtcStateChangeCallbackFunc)(int pc, rtcState state, void *ptr);
+typedef void (*rtcIceStateChangeCallbackFunc)(int pc, rtcIceState state, void *ptr);
+typedef void (*rtcGatheringStateCallbackFunc)(int pc, rtcGatheringState state, void *ptr);
+typedef void (*rtcSignalingStateCallbackFunc)(int pc, rtcSignalingState state, void *ptr);
+typedef void (*rtcDataChannelCallbackFunc)(int pc, int dc, void *ptr);
+typedef void (*rtcOpenCallbackFunc)(int id, void *ptr);
+typedef void (*rtcClosedCallbackFunc)(int id, void *ptr);
+typedef void (*rtcErrorCallbackFunc)(int id, const char *error, void *ptr);
+// The size is negative for a string message, whose null-terminated length is then -size
+typedef void (*rtcMessageCallbackFunc)(int id, const char *message, int size, void *ptr);
+typedef void (*rtcBufferedAmountLowCallbackFunc)(int id, void *ptr);
+
+// Log
+
+// Without a callback, messages are written to stderr
+void rtcInitLogger(rtcLogLevel level, rtcLogCallbackFunc cb);
+
+// User pointer passed to the callbacks of a handle
+void rtcSetUserPointer(int id, void *ptr);
+void *rtcGetUserPointer(int id);
+
+// PeerConnection
+
+typedef struct {
+	const char **iceServers;
+	int iceServersCount;
+	// The following fields are ignored, as browsers do not allow setting them
+	const char *proxyServer;
+	const char *bindAddress;
+	rtcCertificateType certificateType;
+	rtcTransportPolicy iceTransportPolicy;
+	bool enableIceTcp;
+	bool enableIceUdpMux;
+	bool disableAutoNegotiation;
+	bool forceMediaTransport;
+	uint16_t portRangeBegin;
+	uint16_t portRangeEnd;
+	int mtu;
+	int maxMessageSize;
+} rtcConfiguration;
+
+// ICE servers are URLs like "stun:hostname:port" or "turn:username:password@hostname:port"
+int rtcCreatePeerConnection(const rtcConfiguration *config); // returns pc id
+int rtcClosePeerConnection(int pc);
+int rtcDeletePeerConnection(int pc);
+
+int rtcSetLocalDescriptionCallback(int pc, rtcDescriptionCallbackFunc cb);
+int rtcSetLocalCandidateCallback(int pc, rtcCandidateCallbackFunc cb);
+int rtcSetStateChangeCallback(int pc, rtcStateChangeCallbackFunc cb);
+int rtcSetIceStateChangeCallback(int pc, rtcIceStateChangeCallbackFunc cb);
+int rtcSetGatheringStateChangeCallback(int pc, rtcGatheringStateCallbackFunc cb);
+int rtcSetSignalingStateChangeCallback(int pc, rtcSignalingStateCallbackFunc cb);
+
+int rtcSetRemoteDescription(int pc, const char *sdp, const char *type);
+int rtcAddRemoteCandidate(int pc, const char *cand, const char *mid);
+
+// Getters copy the null-terminated string to the buffer and return its size including the
+// terminator, or return the required size if the buffer is NULL
+int rtcGetLocalDescription(int pc, char *buffer, int size);
+int rtcGetRemoteDescription(int pc, char *buffer, int size);
+int rtcGetLocalDescriptionType(int pc, char *buffer, int size);
+int rtcGetRemoteDescriptionType(int pc, char *buffer, int size);
+
+// DataChannel, and WebSocket for the common functions
+
+typedef struct {
+	bool unordered;
+	bool unreliable;
+	unsigned int maxPacketLifeTime; // ignored if reliable
+	unsigned int maxRetransmits;    // ignored if reliable
+} rtcReliability;
+
+typedef struct {
+	rtcReliability reliability;
+	const char *protocol; // ignored, browsers do not allow setting it
+	bool negotiated;      // requires manualStream
+	bool manualStream;    // ignored unless negotiated
+	uint16_t stream;      // numeric ID 0-65534, ignored if manualStream is false
+} rtcDataChannelInit;
+
+int rtcSetDataChannelCallback(int pc, rtcDataChannelCallbackFunc cb);
+int rtcCreateDataChannel(int pc, const char *label); // returns dc id
+int rtcCreateDataChannelEx(int pc, const char *label,
+                           const rtcDataChannelInit *init); // returns dc id
+int rtcDeleteDataChannel(int dc);
+
+int rtcGetDataChannelLabel(int dc, char *buffer, int size);
+int rtcGetDataChannelReliability(int dc, rtcReliability *reliability);
+
+int rtcClose(int id);
+int rtcDelete(int id);
+bool rtcIsOpen(int id);
+bool rtcIsClosed(int id);
+
+int rtcSetOpenCallback(int id, rtcOpenCallbackFunc cb);
+int rtcSetClosedCallback(int id, rtcClosedCallbackFunc cb);
+int rtcSetErrorCallback(int id, rtcErrorCallbackFunc cb);
+int rtcSetMessageCallback(int id, rtcMessageCallbackFunc cb);
+int rtcSetBufferedAmountLowCallback(int id, rtcBufferedAmountLowCallbackFunc cb);
+
+// A negative size sends data as a null-terminated string, returns the size sent
+int rtcSendMessage(int id, const char *data, int size);
+int rtcGetBufferedAmount(int id); // total size buffered to send
+int rtcSetBufferedAmountLowThreshold(int id, int amount);
+
+// WebSocket
+
+int rtcCreateWebSocket(const char *url); // returns ws id
+int rtcDeleteWebSocket(int ws);
+
+// Dummy functions for compatibility with libdatachannel
+
+void rtcPreload(void);
+void rtcCleanup(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
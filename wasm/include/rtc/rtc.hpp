@@ -23,10 +23,19 @@
 #ifndef RTC_H
 #define RTC_H
 
+// C API
+#include "rtc.h"
+
+// C++ API
 #include "common.hpp"
 #include "global.hpp"
 
+#include "bondedchannel.hpp"
+#include "capture.hpp"
 #include "datachannel.hpp"
+#include "message.hpp"
+#include "mux.hpp"
+#include "object.hpp"
 #include "peerconnection.hpp"
 #include "websocket.hpp"
 
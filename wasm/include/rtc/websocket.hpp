@@ -25,6 +25,7 @@
 
 #include "channel.hpp"
 #include "common.hpp"
+#include "object.hpp"
 
 namespace rtc {
 
@@ -45,26 +46,41 @@ public:
 	void close() override;
 	bool send(message_variant data) override;
 	bool send(const byte *data, size_t size) override;
+	bool send(const MessageBuffer &data) override;
+
+	// Stream a registered JS object in chunks without copying it to the wasm heap. Chunks are
+	// sent as binary messages.
+	bool sendObject(ObjectHandle object, TransferInit init = {});
 
 	State readyState() const;
 
 	bool isOpen() const override;
 	bool isClosed() const override;
+	size_t bufferedAmount() const override;
 
 	optional<string> url() const;
 
+	void setBufferedAmountLowThreshold(size_t amount) override;
+
+	// Stop or resume reading incoming messages. This only propagates backpressure to the server
+	// when the browser supports WebSocketStream, otherwise it has no effect.
+	void setReceivePaused(bool paused);
+	bool hasReceiveBackpressure() const;
+
 private:
 	void triggerOpen() override;
 
 	int mId;
 	bool mConnected;
+	size_t mBufferedAmountLowThreshold;
+	bool mReceivePaused;
 
-	static void OpenCallback(void *ptr);
-	static void ErrorCallback(const char *error, void *ptr);
-	static void MessageCallback(const char *data, int size, void *ptr);
+	friend struct impl::Dispatch;
 };
 
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, WebSocket::State state);
+#endif
 
 } // namespace rtc
 
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2017-2022 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+(function() {
+	var Heap = {
+		$RTCHEAP__deps: ['rtcAllocMessageBuffer'],
+		$RTCHEAP: {
+			// Pointers and sizes are BigInt on the wasm side of MEMORY64 builds. Imports declare
+			// their signature so their arguments arrive as numbers, but the pointer-width arguments
+			// the glue passes to exports must be converted back, and pointers they return as well.
+			memory64: {{{ MEMORY64 }}},
+			sendView: null,
+			sendPointer: 0,
+			scratch: null,
+
+			// Return a view of a heap range to pass to send(), which copies synchronously. The view
+			// is reused while the same range is sent again and memory has not grown. Shared memory
+			// cannot be passed to send(), so it is copied to a scratch buffer reused for equal sizes.
+			view: function(pBuffer, size) {
+				var heap = HEAPU8;
+				if(heap.buffer instanceof ArrayBuffer) {
+					var view = RTCHEAP.sendView;
+					if(!view || view.buffer !== heap.buffer || RTCHEAP.sendPointer != pBuffer ||
+					   view.length != size) {
+						view = RTCHEAP.sendView = new Uint8Array(heap.buffer, pBuffer, size);
+						RTCHEAP.sendPointer = pBuffer;
+					}
+					return view;
+				}
+				var scratch = RTCHEAP.scratch;
+				if(!scratch || scratch.length != size)
+					scratch = RTCHEAP.scratch = new Uint8Array(new ArrayBuffer(size));
+				scratch.set(heap.subarray(pBuffer, pBuffer + size));
+				return scratch;
+			},
+
+			// Convert a number to a pointer-width argument for an export
+			ptr: function(value) {
+				return RTCHEAP.memory64 ? BigInt(value) : value;
+			},
+
+			// Allocate a buffer to be adopted by the C++ side, returning its address as a number
+			alloc: function(size) {
+				return Number(_rtcAllocMessageBuffer(RTCHEAP.ptr(size)));
+			},
+
+			// Copy a view of a received ArrayBuffer to the heap
+			write: function(pBuffer, bytes) {
+				HEAPU8.set(bytes, pBuffer);
+			},
+		},
+	};
+
+	mergeInto(LibraryManager.library, Heap);
+})();
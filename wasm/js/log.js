@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2017-2022 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+(function() {
+	var Log = {
+		$RTCLOG__deps: ['rtcDispatchLog', '$RTCHEAP'],
+		$RTCLOG: {
+			level: null,
+
+			// Messages go to the C++ logger once rtc::InitLogger has been called, levels being those
+			// of rtc::LogLevel. Until then, errors are written to the console.
+			log: function(level, message) {
+				if(RTCLOG.level === null) {
+					if(level <= 2) console.error(message);
+					return;
+				}
+				if(level > RTCLOG.level) return;
+				var str = String(message);
+				var strLen = lengthBytesUTF8(str);
+				var pStr = _malloc(strLen+1);
+				stringToUTF8(str, pStr, strLen+1);
+				_rtcDispatchLog(level, RTCHEAP.ptr(pStr));
+				_free(pStr);
+			},
+		},
+
+		rtcSetLogLevel__sig: 'vi',
+		rtcSetLogLevel: function(level) {
+			RTCLOG.level = level;
+		},
+	};
+
+	autoAddDeps(Log, '$RTCLOG');
+	mergeInto(LibraryManager.library, Log);
+})();
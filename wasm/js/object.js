@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2017-2022 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+(function() {
+	var JSObject = {
+		$RTCOBJECT__deps: [
+			'$RTCHEAP',
+			'$RTCLOG',
+			'rtcDispatchTransferProgress',
+			'rtcDispatchTransferComplete',
+		],
+		$RTCOBJECT__postset: "Module['rtcRegisterObject'] = RTCOBJECT.register;" +
+			"Module['rtcReleaseObject'] = RTCOBJECT.release;",
+		$RTCOBJECT: {
+			counter: 0,
+			map: {},
+			highWaterMark: 1024 * 1024,
+			pollInterval: 5, // ms
+
+			register: function(object) {
+				var handle = ++RTCOBJECT.counter;
+				RTCOBJECT.map[handle] = object;
+				return handle;
+			},
+
+			release: function(handle) {
+				delete RTCOBJECT.map[handle];
+			},
+
+			// Send the object in chunks over a RTCDataChannel or WebSocket, reading Blob slices
+			// asynchronously and waiting for the channel to drain. Only progress and completion
+			// are reported to the wasm side.
+			transfer: function(channel, handle, chunkSize, pTransfer) {
+				var object = RTCOBJECT.map[handle];
+				if(!object) return 0;
+				var isBlob = typeof Blob != 'undefined' && object instanceof Blob;
+				var total = isBlob ? object.size : object.byteLength;
+				var offset = 0;
+				var transfer = RTCHEAP.ptr(pTransfer);
+				var isOpen = function() {
+					// Deleting the channel from C++ leaves it open, but ends its transfers
+					if(channel.rtcUserDeleted) return false;
+					return channel.readyState == 'open' || channel.readyState == 1;
+				};
+				var complete = function(success) {
+					_rtcDispatchTransferComplete(success ? 1 : 0, transfer);
+				};
+				var send = function(chunk) {
+					try {
+						channel.send(chunk);
+					} catch(e) {
+						RTCLOG.log(2, 'Transfer failed: ' + e);
+						return false;
+					}
+					offset += chunk.byteLength;
+					_rtcDispatchTransferProgress(offset, total, transfer);
+					return true;
+				};
+				var pump = function() {
+					while(offset < total) {
+						if(!isOpen()) return complete(false);
+						if(channel.bufferedAmount > RTCOBJECT.highWaterMark) {
+							setTimeout(pump, RTCOBJECT.pollInterval);
+							return;
+						}
+						var end = Math.min(offset + chunkSize, total);
+						if(isBlob) {
+							object.slice(offset, end).arrayBuffer().then(function(buffer) {
+								if(!isOpen() || !send(buffer)) return complete(false);
+								pump();
+							}, function() {
+								complete(false);
+							});
+							return;
+						}
+						var chunk = ArrayBuffer.isView(object) ?
+							new Uint8Array(object.buffer, object.byteOffset + offset, end - offset) :
+							new Uint8Array(object, offset, end - offset);
+						if(!send(chunk)) return complete(false);
+					}
+					complete(true);
+				};
+				// Start after returning so that callbacks never run from within the send call
+				Promise.resolve().then(pump);
+				return 1;
+			},
+		},
+
+		rtcReleaseObject__sig: 'vi',
+		rtcReleaseObject: function(handle) {
+			RTCOBJECT.release(handle);
+		},
+
+		rtcDownloadBuffer__sig: 'ippp',
+		rtcDownloadBuffer: function(pBuffer, size, pFilename) {
+			if(typeof document == 'undefined') {
+				RTCLOG.log(2, 'Download is only available in browsers');
+				return 0;
+			}
+			var bytes = Module['HEAPU8'].slice(pBuffer, pBuffer + size);
+			var url = URL.createObjectURL(new Blob([bytes]));
+			var link = document.createElement('a');
+			link.href = url;
+			link.download = UTF8ToString(pFilename);
+			link.click();
+			setTimeout(function() {
+				URL.revokeObjectURL(url);
+			}, 0);
+			return 1;
+		},
+	};
+
+	autoAddDeps(JSObject, '$RTCOBJECT');
+	mergeInto(LibraryManager.library, JSObject);
+})();
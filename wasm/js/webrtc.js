@@ -22,10 +22,59 @@
 
 (function() {
 	var WebRTC = {
+		$WEBRTC__deps: [
+			'rtcDispatchDataChannel',
+			'rtcDispatchLocalDescription',
+			'rtcDispatchLocalCandidate',
+			'rtcDispatchStateChange',
+			'rtcDispatchIceStateChange',
+			'rtcDispatchGatheringStateChange',
+			'rtcDispatchSignalingStateChange',
+			'rtcDispatchOpen',
+			'rtcDispatchError',
+			'rtcDispatchMessage',
+			'rtcDispatchBufferedAmountLow',
+			'rtcDispatchForwardedSend',
+			'$RTCHEAP',
+			'$RTCLOG',
+			'rtcAllocMessageBuffer',
+		],
 		$WEBRTC: {
 			peerConnectionsMap: {},
 			dataChannelsMap: {},
 			nextId: 1,
+			priorities: ['very-low', 'low', 'medium', 'high'],
+
+			// State values matching the enums of rtc::PeerConnection
+			connectionStates: {
+				'new': 0,
+				'connecting': 1,
+				'connected': 2,
+				'disconnected': 3,
+				'failed': 4,
+				'closed': 5,
+			},
+			iceStates: {
+				'new': 0,
+				'checking': 1,
+				'connected': 2,
+				'completed': 3,
+				'failed': 4,
+				'disconnected': 5,
+				'closed': 6,
+			},
+			gatheringStates: {
+				'new': 0,
+				'gathering': 1,
+				'complete': 2,
+			},
+			signalingStates: {
+				'stable': 0,
+				'have-local-offer': 1,
+				'have-remote-offer': 2,
+				'have-local-pranswer': 3,
+				'have-remote-pranswer': 4,
+			},
 
 			allocUTF8FromString: function(str) {
 				var strLen = lengthBytesUTF8(str);
@@ -34,6 +83,33 @@
 				return strOnHeap;
 			},
 
+			// Timeline entries are flattened as [event, value, time] with event codes matching
+			// rtc::PeerConnection::Timeline in a preallocated array, and entries past its capacity
+			// are dropped. They are optionally mirrored as performance marks named after the name and
+			// optional suffix, which are only concatenated in that case.
+			timelineCapacity: 256,
+			recordTimeline: function(peerConnection, event, value, name, suffix) {
+				var time = performance.now();
+				var timeline = peerConnection.rtcTimeline;
+				if(timeline.count < WEBRTC.timelineCapacity) {
+					var i = 3 * timeline.count++;
+					timeline.entries[i] = event;
+					timeline.entries[i+1] = value;
+					timeline.entries[i+2] = time;
+				}
+				if(peerConnection.rtcTimelineMarks && typeof performance.mark == 'function') {
+					var mark = 'rtc-pc' + peerConnection.rtcId + '-' + name + (suffix || '');
+					performance.mark(mark, {startTime: time});
+				}
+			},
+
+			// The implementation may be overridden with Module['RTCPeerConnection'],
+			// for instance to run against a simulated network.
+			getRTCPeerConnection: function() {
+				if(Module['RTCPeerConnection']) return Module['RTCPeerConnection'];
+				return typeof RTCPeerConnection != 'undefined' ? RTCPeerConnection : null;
+			},
+
 			registerPeerConnection: function(peerConnection) {
 				var pc = WEBRTC.nextId++;
 				WEBRTC.peerConnectionsMap[pc] = peerConnection;
@@ -43,7 +119,7 @@
 							return WEBRTC.handleDescription(peerConnection, offer);
 						})
 						.catch(function(err) {
-							console.error(err);
+							RTCLOG.log(2, 'Failed to create offer: ' + err);
 						});
 				};
 				peerConnection.onicecandidate = function(evt) {
@@ -62,124 +138,217 @@
 				peerConnection.onsignalingstatechange = function() {
 					WEBRTC.handleSignalingStateChange(peerConnection, peerConnection.signalingState)
 				};
+				peerConnection.ondatachannel = function(evt) {
+					if(peerConnection.rtcUserDeleted) return;
+					var userPointer = peerConnection.rtcUserPointer || 0;
+					if(!userPointer) return;
+					var dc = WEBRTC.registerDataChannel(evt.channel, peerConnection);
+					_rtcDispatchDataChannel(pc, dc, userPointer);
+				};
+				peerConnection.rtcId = pc;
+				peerConnection.rtcTimeline = {
+					entries: new Float64Array(3 * WEBRTC.timelineCapacity),
+					count: 0,
+					labels: [],
+				};
 				return pc;
 			},
 
-			registerDataChannel: function(dataChannel) {
+			// Apply the forwarding rules of the channel to a received message, returning whether it
+			// must still be delivered to the wasm side
+			// Binary messages come with the view also used to copy them to the heap, so that
+			// reading the type byte does not create another object
+			forwardMessage: function(dataChannel, data, bytes) {
+				var rules = dataChannel.rtcForwardingRules;
+				if(!rules || !rules.length) return true;
+				var type = bytes && bytes.length > 0 ? bytes[0] : -1;
+				var matched = false;
+				var deliver = false;
+				for(var i = 0; i < rules.length; ++i) {
+					var rule = rules[i];
+					if(rule.type >= 0 && rule.type != type) continue;
+					matched = true;
+					deliver = deliver || rule.deliver;
+					for(var j = 0; j < rule.targets.length; ++j) {
+						var target = WEBRTC.dataChannelsMap[rule.targets[j]];
+						if(target && target.readyState == 'open') WEBRTC.forwardTo(target, data, bytes);
+					}
+				}
+				return !matched || deliver;
+			},
+
+			forwardTo: function(target, data, bytes) {
+				target.send(data);
+				var accounting = target.rtcSendAccounting;
+				if(!accounting || target.rtcUserDeleted) return;
+				var size = bytes ? bytes.length : lengthBytesUTF8(data);
+				if(accounting == 1) {
+					// Sum metrics here for webrtcGetForwardedMetric, without entering wasm
+					var metrics = target.rtcForwardedMetrics;
+					if(!metrics) metrics = target.rtcForwardedMetrics = new Float64Array(3 + 16);
+					metrics[0] += 1;
+					metrics[1] += size;
+					metrics[2] = Math.max(metrics[2], target.bufferedAmount);
+					var bucket = 0;
+					for(var limit = 16; size > limit && bucket < 15; limit *= 2) ++bucket;
+					metrics[3 + bucket] += 1;
+					return;
+				}
+				// Report the send to the send scheduler of the channel
+				if(!target.rtcUserPointer) return;
+				_rtcDispatchForwardedSend(target.rtcId, RTCHEAP.ptr(size),
+				                          RTCHEAP.ptr(target.bufferedAmount), target.rtcUserPointer);
+			},
+
+			registerDataChannel: function(dataChannel, peerConnection) {
 				var dc = WEBRTC.nextId++;
 				WEBRTC.dataChannelsMap[dc] = dataChannel;
 				dataChannel.binaryType = 'arraybuffer';
+				dataChannel.rtcId = dc;
+				dataChannel.onopen = function() {
+					if(!dataChannel.rtcOpenRecorded) {
+						dataChannel.rtcOpenRecorded = true;
+						// Labels are only kept along with their entry
+						var timeline = peerConnection.rtcTimeline;
+						var index = timeline.labels.length;
+						if(timeline.count < WEBRTC.timelineCapacity) timeline.labels.push(dataChannel.label);
+						WEBRTC.recordTimeline(peerConnection, 7, index, 'datachannel-open-', dataChannel.label);
+					}
+					if(dataChannel.rtcUserDeleted) return;
+					var userPointer = dataChannel.rtcUserPointer || 0;
+					if(!userPointer) return;
+					_rtcDispatchOpen(dc, userPointer);
+				};
+				dataChannel.onerror = function(evt) {
+					if(dataChannel.rtcUserDeleted) return;
+					var userPointer = dataChannel.rtcUserPointer || 0;
+					if(!userPointer) return;
+					var pError = evt.message ? WEBRTC.allocUTF8FromString(evt.message) : 0;
+					_rtcDispatchError(dc, RTCHEAP.ptr(pError), userPointer);
+					_free(pError);
+				};
+				dataChannel.onmessage = function(evt) {
+					if(dataChannel.rtcUserDeleted) return;
+					var data = evt.data;
+					var rules = dataChannel.rtcForwardingRules;
+					if(!dataChannel.rtcUserPointer && !(rules && rules.length)) return;
+					// The one view per binary message needed to read the browser's ArrayBuffer
+					var bytes = typeof data == 'string' ? null : new Uint8Array(data);
+					if(!WEBRTC.forwardMessage(dataChannel, data, bytes)) return;
+					// Reporting forwarded sends may have deleted the channel
+					if(dataChannel.rtcUserDeleted) return;
+					var userPointer = dataChannel.rtcUserPointer || 0;
+					if(!userPointer) return;
+					if(!bytes) {
+						var str = data;
+						var strLen = lengthBytesUTF8(str);
+						var pStr = RTCHEAP.alloc(strLen+1);
+						stringToUTF8(str, pStr, strLen+1);
+						_rtcDispatchMessage(dc, RTCHEAP.ptr(pStr), RTCHEAP.ptr(-(strLen+1)), userPointer);
+					} else {
+						var size = bytes.length;
+						var pBuffer = RTCHEAP.alloc(size);
+						RTCHEAP.write(pBuffer, bytes);
+						_rtcDispatchMessage(dc, RTCHEAP.ptr(pBuffer), RTCHEAP.ptr(size), userPointer);
+					}
+				};
+				dataChannel.onclose = function() {
+					if(dataChannel.rtcUserDeleted) return;
+					var userPointer = dataChannel.rtcUserPointer || 0;
+					if(!userPointer) return;
+					_rtcDispatchMessage(dc, RTCHEAP.ptr(0), RTCHEAP.ptr(0), userPointer);
+				};
+				dataChannel.onbufferedamountlow = function() {
+					if(dataChannel.rtcUserDeleted) return;
+					var userPointer = dataChannel.rtcUserPointer || 0;
+					if(!userPointer) return;
+					_rtcDispatchBufferedAmountLow(dc, userPointer);
+				};
 				return dc;
 			},
 
 			handleDescription: function(peerConnection, description) {
 				return peerConnection.setLocalDescription(description)
 					.then(function() {
+						WEBRTC.recordTimeline(peerConnection, 1, 0, 'local-description');
 						if(peerConnection.rtcUserDeleted) return;
-						if(!peerConnection.rtcDescriptionCallback) return;
+						var userPointer = peerConnection.rtcUserPointer || 0;
+						if(!userPointer) return;
 						var desc = peerConnection.localDescription;
 						var pSdp = WEBRTC.allocUTF8FromString(desc.sdp);
 						var pType = WEBRTC.allocUTF8FromString(desc.type);
-						var callback =  peerConnection.rtcDescriptionCallback;
-						var userPointer = peerConnection.rtcUserPointer || 0;
-						{{{ makeDynCall('viii', 'callback') }}} (pSdp, pType, userPointer);
+						_rtcDispatchLocalDescription(peerConnection.rtcId, RTCHEAP.ptr(pSdp),
+						                             RTCHEAP.ptr(pType), userPointer);
 						_free(pSdp);
 						_free(pType);
 					});
 			},
 
 			handleCandidate: function(peerConnection, candidate) {
+				WEBRTC.recordTimeline(peerConnection, 2, 0, 'local-candidate');
 				if(peerConnection.rtcUserDeleted) return;
-				if(!peerConnection.rtcCandidateCallback) return;
+				var userPointer = peerConnection.rtcUserPointer || 0;
+				if(!userPointer) return;
 				var pCandidate = WEBRTC.allocUTF8FromString(candidate.candidate);
 				var pSdpMid = WEBRTC.allocUTF8FromString(candidate.sdpMid);
-				var candidateCallback =  peerConnection.rtcCandidateCallback;
-				var userPointer = peerConnection.rtcUserPointer || 0;
-				{{{ makeDynCall('viii', 'candidateCallback') }}} (pCandidate, pSdpMid, userPointer);
+				_rtcDispatchLocalCandidate(peerConnection.rtcId, RTCHEAP.ptr(pCandidate),
+				                           RTCHEAP.ptr(pSdpMid), userPointer);
 				_free(pCandidate);
 				_free(pSdpMid);
 			},
 
 			handleConnectionStateChange: function(peerConnection, connectionState) {
 				if(peerConnection.rtcUserDeleted) return;
-				if(!peerConnection.rtcStateChangeCallback) return;
-				var map = {
-					'new': 0,
-					'connecting': 1,
-					'connected': 2,
-					'disconnected': 3,
-					'failed': 4,
-					'closed': 5,
-				};
-				if(connectionState in map) {
-					var stateChangeCallback = peerConnection.rtcStateChangeCallback;
-					var userPointer = peerConnection.rtcUserPointer || 0;
-					{{{ makeDynCall('vii', 'stateChangeCallback') }}} (map[connectionState], userPointer);
-				}
+				var userPointer = peerConnection.rtcUserPointer || 0;
+				if(!userPointer) return;
+				var state = WEBRTC.connectionStates[connectionState];
+				if(state === undefined) return;
+				WEBRTC.recordTimeline(peerConnection, 4, state, 'state-', connectionState);
+				_rtcDispatchStateChange(peerConnection.rtcId, state, userPointer);
 			},
 
-      handleIceStateChange: function(peerConnection, iceConnectionState) {
+			handleIceStateChange: function(peerConnection, iceConnectionState) {
 				if(peerConnection.rtcUserDeleted) return;
-				if(!peerConnection.rtcIceStateChangeCallback) return;
-				var map = {
-					'new': 0,
-					'checking': 1,
-					'connected': 2,
-					'completed': 3,
-					'failed': 4,
-					'disconnected': 5,
-					'closed': 6,
-				};
-				if(iceConnectionState in map) {
-					var iceStateChangeCallback = peerConnection.rtcIceStateChangeCallback;
-					var userPointer = peerConnection.rtcUserPointer || 0;
-					{{{ makeDynCall('vii', 'iceStateChangeCallback') }}} (map[iceConnectionState], userPointer);
-				}
+				var userPointer = peerConnection.rtcUserPointer || 0;
+				if(!userPointer) return;
+				var state = WEBRTC.iceStates[iceConnectionState];
+				if(state === undefined) return;
+				WEBRTC.recordTimeline(peerConnection, 5, state, 'ice-', iceConnectionState);
+				_rtcDispatchIceStateChange(peerConnection.rtcId, state, userPointer);
 			},
 
 			handleGatheringStateChange: function(peerConnection, iceGatheringState) {
 				if(peerConnection.rtcUserDeleted) return;
-				if(!peerConnection.rtcGatheringStateChangeCallback) return;
-				var map = {
-					'new': 0,
-					'gathering': 1,
-					'complete': 2,
-				};
-				if(iceGatheringState in map) {
-					var gatheringStateChangeCallback = peerConnection.rtcGatheringStateChangeCallback;
-					var userPointer = peerConnection.rtcUserPointer || 0;
-					{{{ makeDynCall('vii', 'gatheringStateChangeCallback') }}} (map[iceGatheringState], userPointer);
-				}
+				var userPointer = peerConnection.rtcUserPointer || 0;
+				if(!userPointer) return;
+				var state = WEBRTC.gatheringStates[iceGatheringState];
+				if(state === undefined) return;
+				WEBRTC.recordTimeline(peerConnection, 6, state, 'gathering-', iceGatheringState);
+				_rtcDispatchGatheringStateChange(peerConnection.rtcId, state, userPointer);
 			},
 
 			handleSignalingStateChange: function(peerConnection, signalingState) {
 				if(peerConnection.rtcUserDeleted) return;
-				if(!peerConnection.rtcSignalingStateChangeCallback) return;
-				var map = {
-					'stable': 0,
-					'have-local-offer': 1,
-					'have-remote-offer': 2,
-					'have-local-pranswer': 3,
-					'have-remote-pranswer': 4,
-				};
-				if(signalingState in map) {
-					var signalingStateChangeCallback = peerConnection.rtcSignalingStateChangeCallback;
-					var userPointer = peerConnection.rtcUserPointer || 0;
-					{{{ makeDynCall('vii', 'signalingStateChangeCallback') }}} (map[signalingState], userPointer);
-				}
+				var userPointer = peerConnection.rtcUserPointer || 0;
+				if(!userPointer) return;
+				var state = WEBRTC.signalingStates[signalingState];
+				if(state === undefined) return;
+				_rtcDispatchSignalingStateChange(peerConnection.rtcId, state, userPointer);
 			},
 		},
 
-		rtcCreatePeerConnection: function(pUrls, pUsernames, pPasswords, nIceServers) {
-			if(!window.RTCPeerConnection) return 0;
+		webrtcCreatePeerConnection__sig: 'ipppii',
+		webrtcCreatePeerConnection: function(pUrls, pUsernames, pPasswords, nIceServers, timelineMarks) {
+			var RTCPeerConnection = WEBRTC.getRTCPeerConnection();
+			if(!RTCPeerConnection) return 0;
 			var iceServers = [];
 			for(var i = 0; i < nIceServers; ++i) {
-				var heap = Module['HEAPU32'];
-				var pUrl = heap[pUrls/heap.BYTES_PER_ELEMENT + i];
+				// Arrays of pointers, whose width depends on MEMORY64
+				var pUrl = {{{ makeGetValue('pUrls', 'i*' + POINTER_SIZE, '*') }}};
 				var url = UTF8ToString(pUrl);
-				var pUsername = heap[pUsernames/heap.BYTES_PER_ELEMENT + i];
+				var pUsername = {{{ makeGetValue('pUsernames', 'i*' + POINTER_SIZE, '*') }}};
 				var username = UTF8ToString(pUsername);
-				var pPassword = heap[pPasswords/heap.BYTES_PER_ELEMENT + i];
+				var pPassword = {{{ makeGetValue('pPasswords', 'i*' + POINTER_SIZE, '*') }}};
 				var password = UTF8ToString(pPassword);
 				if (username == "") {
 					iceServers.push({
@@ -196,10 +365,15 @@
 			var config = {
 				iceServers: iceServers,
 			};
-			return WEBRTC.registerPeerConnection(new RTCPeerConnection(config));
+			var pc = WEBRTC.registerPeerConnection(new RTCPeerConnection(config));
+			var peerConnection = WEBRTC.peerConnectionsMap[pc];
+			peerConnection.rtcTimelineMarks = !!timelineMarks;
+			WEBRTC.recordTimeline(peerConnection, 0, 0, 'created');
+			return pc;
 		},
 
-		rtcDeletePeerConnection: function(pc) {
+		webrtcDeletePeerConnection__sig: 'vi',
+		webrtcDeletePeerConnection: function(pc) {
 			var peerConnection = WEBRTC.peerConnectionsMap[pc];
 			if(peerConnection) {
 				peerConnection.close();
@@ -208,7 +382,8 @@
 			}
 		},
 
-		rtcGetLocalDescription: function(pc) {
+		webrtcGetLocalDescription__sig: 'pi',
+		webrtcGetLocalDescription: function(pc) {
 			if(!pc) return 0;
 			var peerConnection = WEBRTC.peerConnectionsMap[pc];
 			var localDescription = peerConnection.localDescription;
@@ -218,7 +393,8 @@
 			return sdp;
 		},
 
-		rtcGetLocalDescriptionType: function(pc) {
+		webrtcGetLocalDescriptionType__sig: 'pi',
+		webrtcGetLocalDescriptionType: function(pc) {
 			if(!pc) return 0;
 			var peerConnection = WEBRTC.peerConnectionsMap[pc];
 			var localDescription = peerConnection.localDescription;
@@ -228,7 +404,8 @@
 			return type;
 		},
 
-    rtcGetRemoteDescription: function(pc) {
+		webrtcGetRemoteDescription__sig: 'pi',
+		webrtcGetRemoteDescription: function(pc) {
 			if(!pc) return 0;
 			var peerConnection = WEBRTC.peerConnectionsMap[pc];
 			var remoteDescription = peerConnection.remoteDescription;
@@ -238,7 +415,8 @@
 			return sdp;
 		},
 
-		rtcGetRemoteDescriptionType: function(pc) {
+		webrtcGetRemoteDescriptionType__sig: 'pi',
+		webrtcGetRemoteDescriptionType: function(pc) {
 			if(!pc) return 0;
 			var peerConnection = WEBRTC.peerConnectionsMap[pc];
 			var remoteDescription = peerConnection.remoteDescription;
@@ -248,23 +426,32 @@
 			return type;
 		},
 
-		rtcCreateDataChannel: function(pc, pLabel, unordered, maxRetransmits, maxPacketLifeTime) {
+		webrtcCreateDataChannel__sig: 'iipiiiii',
+		webrtcCreateDataChannel: function(pc, pLabel, unordered, maxRetransmits, maxPacketLifeTime, priority, id) {
 			if(!pc) return 0;
 			var label = UTF8ToString(pLabel);
 			var peerConnection = WEBRTC.peerConnectionsMap[pc];
 			var datachannelInit = {
 				ordered: !unordered,
+				priority: WEBRTC.priorities[priority] || 'low',
 			};
 
 			// Browsers throw an exception when both are present (even if set to null)
 			if (maxRetransmits >= 0) datachannelInit.maxRetransmits = maxRetransmits;
 			else if (maxPacketLifeTime >= 0) datachannelInit.maxPacketLifeTime = maxPacketLifeTime;
 
+			// A negotiated channel is not announced, the remote peer creates it with the same id
+			if (id >= 0) {
+				datachannelInit.negotiated = true;
+				datachannelInit.id = id;
+			}
+
 			var channel = peerConnection.createDataChannel(label, datachannelInit);
-			return WEBRTC.registerDataChannel(channel);
+			return WEBRTC.registerDataChannel(channel, peerConnection);
 		},
 
- 		rtcDeleteDataChannel: function(dc) {
+		webrtcDeleteDataChannel__sig: 'vi',
+		webrtcDeleteDataChannel: function(dc) {
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
 			if(dataChannel) {
 				dataChannel.rtcUserDeleted = true;
@@ -272,61 +459,16 @@
 			}
 		},
 
-		rtcSetDataChannelCallback: function(pc, dataChannelCallback) {
-			if(!pc) return;
-			var peerConnection = WEBRTC.peerConnectionsMap[pc];
-			peerConnection.ondatachannel = function(evt) {
-				if(peerConnection.rtcUserDeleted) return;
-				var dc = WEBRTC.registerDataChannel(evt.channel);
-				var userPointer = peerConnection.rtcUserPointer || 0;
-				{{{ makeDynCall('vii', 'dataChannelCallback') }}} (dc, userPointer);
-			};
-		},
-
-		rtcSetLocalDescriptionCallback: function(pc, descriptionCallback) {
-			if(!pc) return;
-			var peerConnection = WEBRTC.peerConnectionsMap[pc];
-			peerConnection.rtcDescriptionCallback = descriptionCallback;
-		},
-
-		rtcSetLocalCandidateCallback: function(pc, candidateCallback) {
-			if(!pc) return;
-			var peerConnection = WEBRTC.peerConnectionsMap[pc];
-			peerConnection.rtcCandidateCallback = candidateCallback;
-		},
-
-		rtcSetStateChangeCallback: function(pc, stateChangeCallback) {
-			if(!pc) return;
-			var peerConnection = WEBRTC.peerConnectionsMap[pc];
-			peerConnection.rtcStateChangeCallback = stateChangeCallback;
-		},
-
-		rtcSetIceStateChangeCallback: function(pc, iceStateChangeCallback) {
-			if(!pc) return;
-			var peerConnection = WEBRTC.peerConnectionsMap[pc];
-			peerConnection.rtcIceStateChangeCallback = iceStateChangeCallback;
-		},
-
-		rtcSetGatheringStateChangeCallback: function(pc, gatheringStateChangeCallback) {
-			if(!pc) return;
-			var peerConnection = WEBRTC.peerConnectionsMap[pc];
-			peerConnection.rtcGatheringStateChangeCallback = gatheringStateChangeCallback;
-		},
-
-		rtcSetSignalingStateChangeCallback: function(pc, signalingStateChangeCallback) {
-			if(!pc) return;
-			var peerConnection = WEBRTC.peerConnectionsMap[pc];
-			peerConnection.rtcSignalingStateChangeCallback = signalingStateChangeCallback;
-		},
-
-		rtcSetRemoteDescription: function(pc, pSdp, pType) {
-			var description = new RTCSessionDescription({
+		webrtcSetRemoteDescription__sig: 'vipp',
+		webrtcSetRemoteDescription: function(pc, pSdp, pType) {
+			var description = {
 				sdp: UTF8ToString(pSdp),
 				type: UTF8ToString(pType),
-			});
+			};
 			var peerConnection = WEBRTC.peerConnectionsMap[pc];
 			peerConnection.setRemoteDescription(description)
 				.then(function() {
+					WEBRTC.recordTimeline(peerConnection, 3, 0, 'remote-description');
 					if(peerConnection.rtcUserDeleted) return;
 					if(description.type == 'offer') {
 						peerConnection.createAnswer()
@@ -334,151 +476,191 @@
 								return WEBRTC.handleDescription(peerConnection, answer);
 							})
 							.catch(function(err) {
-								console.error(err);
+								RTCLOG.log(2, 'Failed to create answer: ' + err);
 							});
 					}
 				})
 				.catch(function(err) {
-					console.error(err);
+					RTCLOG.log(2, 'Failed to set remote description: ' + err);
 				});
 		},
 
-		rtcAddRemoteCandidate: function(pc, pCandidate, pSdpMid) {
-			var iceCandidate = new RTCIceCandidate({
+		webrtcAddRemoteCandidate__sig: 'vipp',
+		webrtcAddRemoteCandidate: function(pc, pCandidate, pSdpMid) {
+			var iceCandidate = {
 				candidate: UTF8ToString(pCandidate),
 				sdpMid: UTF8ToString(pSdpMid),
-			});
+			};
 			var peerConnection = WEBRTC.peerConnectionsMap[pc];
 			peerConnection.addIceCandidate(iceCandidate)
 				.catch(function(err) {
-					console.error(err);
+					RTCLOG.log(2, 'Failed to add remote candidate: ' + err);
 				});
 		},
 
-		rtcGetDataChannelLabel: function(dc, pBuffer, size) {
+		webrtcGetDataChannelLabel__sig: 'iipp',
+		webrtcGetDataChannelLabel: function(dc, pBuffer, size) {
 			if(!dc) return 0;
 			var label = WEBRTC.dataChannelsMap[dc].label;
 			stringToUTF8(label, pBuffer, size);
 			return lengthBytesUTF8(label);
 		},
 
-		rtcGetDataChannelUnordered: function(dc) {
+		webrtcGetDataChannelUnordered__sig: 'ii',
+		webrtcGetDataChannelUnordered: function(dc) {
 			if(!dc) return 0;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
 			return dataChannel.ordered ? 0 : 1;
 		},
 
-		rtcGetDataChannelMaxPacketLifeTime: function(dc) {
+		webrtcGetDataChannelMaxPacketLifeTime__sig: 'ii',
+		webrtcGetDataChannelMaxPacketLifeTime: function(dc) {
 			if(!dc) return -1;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
 			return dataChannel.maxPacketLifeTime !== null ? dataChannel.maxPacketLifeTime : -1;
 		},
 
-		rtcGetDataChannelMaxRetransmits: function(dc) {
-			if(!dc) return -1;
+		webrtcGetDataChannelPriority__sig: 'ii',
+		webrtcGetDataChannelPriority: function(dc) {
+			if(!dc) return 1;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
-			return dataChannel.maxRetransmits !== null ? dataChannel.maxRetransmits : -1;
+			var index = WEBRTC.priorities.indexOf(dataChannel.priority);
+			return index >= 0 ? index : 1;
 		},
 
-		rtcSetOpenCallback: function(dc, openCallback) {
-			if(!dc) return;
+		webrtcAddForwardingRule__sig: 'iipiii',
+		webrtcAddForwardingRule: function(dc, pTargets, count, type, deliver) {
+			if(!dc) return 0;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
-			var cb = function() {
-				if(dataChannel.rtcUserDeleted) return;
-				var userPointer = dataChannel.rtcUserPointer || 0;
-				{{{ makeDynCall('vi', 'openCallback') }}} (userPointer);
-			};
-			dataChannel.onopen = cb;
-			if(dataChannel.readyState == 'open') setTimeout(cb, 0);
+			var targets = [];
+			for(var i = 0; i < count; ++i) targets.push({{{ makeGetValue('pTargets', 'i*4', 'i32') }}});
+			var rule = {id: WEBRTC.nextId++, targets: targets, type: type, deliver: !!deliver};
+			if(!dataChannel.rtcForwardingRules) dataChannel.rtcForwardingRules = [];
+			dataChannel.rtcForwardingRules.push(rule);
+			return rule.id;
 		},
 
-		rtcSetErrorCallback: function(dc, errorCallback) {
+		webrtcRemoveForwardingRule__sig: 'vii',
+		webrtcRemoveForwardingRule: function(dc, id) {
 			if(!dc) return;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
-			var cb = function(evt) {
-				if(dataChannel.rtcUserDeleted) return;
-				var userPointer = dataChannel.rtcUserPointer || 0;
-				var pError = evt.message ? WEBRTC.allocUTF8FromString(evt.message) : 0;
-				{{{ makeDynCall('vii', 'errorCallback') }}} (pError, userPointer);
-				_free(pError);
-			};
-			dataChannel.onerror = cb;
+			var rules = dataChannel.rtcForwardingRules;
+			if(!rules) return;
+			dataChannel.rtcForwardingRules = rules.filter(function(rule) {
+				return rule.id != id;
+			});
 		},
 
-		rtcSetMessageCallback: function(dc, messageCallback) {
+		// Mode 0 ignores forwarded sends, 1 sums their metrics, and 2 reports each one to wasm
+		webrtcSetSendAccounting__sig: 'vii',
+		webrtcSetSendAccounting: function(dc, mode) {
 			if(!dc) return;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
-			dataChannel.onmessage = function(evt) {
-				if(dataChannel.rtcUserDeleted) return;
-				var userPointer = dataChannel.rtcUserPointer || 0;
-				if(typeof evt.data == 'string') {
-					var pStr = WEBRTC.allocUTF8FromString(evt.data);
-					{{{ makeDynCall('viii', 'messageCallback') }}} (pStr, -1, userPointer);
-					_free(pStr);
-				} else {
-					var byteArray = new Uint8Array(evt.data);
-					var size = byteArray.length;
-					var pBuffer = _malloc(size);
-					var heapBytes = new Uint8Array(Module['HEAPU8'].buffer, pBuffer, size);
-					heapBytes.set(byteArray);
-					{{{ makeDynCall('viii', 'messageCallback') }}} (pBuffer, size, userPointer);
-					_free(pBuffer);
-				}
-			};
-			dataChannel.onclose = function() {
-				if(dataChannel.rtcUserDeleted) return;
-				var userPointer = dataChannel.rtcUserPointer || 0;
-				{{{ makeDynCall('viii', 'messageCallback') }}} (0, 0, userPointer);
-			};
+			dataChannel.rtcSendAccounting = mode;
 		},
 
-		rtcSetBufferedAmountLowCallback: function(dc, bufferedAmountLowCallback) {
-			if(!dc) return;
+		webrtcGetForwardedMetric__sig: 'dii',
+		webrtcGetForwardedMetric: function(dc, index) {
+			if(!dc) return 0;
+			var metrics = WEBRTC.dataChannelsMap[dc].rtcForwardedMetrics;
+			return metrics ? metrics[index] : 0;
+		},
+
+		webrtcGetDataChannelMaxRetransmits__sig: 'ii',
+		webrtcGetDataChannelMaxRetransmits: function(dc) {
+			if(!dc) return -1;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
-			var cb = function(evt) {
-				if(dataChannel.rtcUserDeleted) return;
-				var userPointer = dataChannel.rtcUserPointer || 0;
-				{{{ makeDynCall('vi', 'bufferedAmountLowCallback') }}} (userPointer);
-			};
-			dataChannel.onbufferedamountlow = cb;
+			return dataChannel.maxRetransmits !== null ? dataChannel.maxRetransmits : -1;
 		},
 
-		rtcGetBufferedAmount: function(dc) {
+		webrtcGetBufferedAmount__sig: 'pi',
+		webrtcGetBufferedAmount: function(dc) {
 			if(!dc) return 0;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
 			return dataChannel.bufferedAmount;
 		},
 
-		rtcSetBufferedAmountLowThreshold: function(dc, threshold) {
+		webrtcSetBufferedAmountLowThreshold__sig: 'vip',
+		webrtcSetBufferedAmountLowThreshold: function(dc, threshold) {
 			if(!dc) return;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
 			dataChannel.bufferedAmountLowThreshold = threshold;
 		},
 
-		rtcSendMessage: function(dc, pBuffer, size) {
+		webrtcSendMessage__sig: 'pippi',
+		webrtcSendMessage: function(dc, pBuffer, size, isString) {
 			if(!dc) return -1;
 			var dataChannel = WEBRTC.dataChannelsMap[dc];
 			if(dataChannel.readyState != 'open') return -1;
-			if(size >= 0) {
-				var heapBytes = new Uint8Array(Module['HEAPU8'].buffer, pBuffer, size);
-				if(heapBytes.buffer instanceof ArrayBuffer) {
-					dataChannel.send(heapBytes);
-				} else {
-					var byteArray = new Uint8Array(new ArrayBuffer(size));
-					byteArray.set(heapBytes);
-					dataChannel.send(byteArray);
-				}
-				return size;
+			if(!isString) {
+				dataChannel.send(RTCHEAP.view(pBuffer, size));
+				return dataChannel.bufferedAmount;
 			} else {
-				var str = UTF8ToString(pBuffer);
+				var str = UTF8ToString(pBuffer, size);
 				dataChannel.send(str);
-				return lengthBytesUTF8(str);
+				return dataChannel.bufferedAmount;
+			}
+		},
+
+		webrtcBroadcastMessage__sig: 'vpippip',
+		webrtcBroadcastMessage: function(pDcs, count, pBuffer, size, isString, pResults) {
+			// Materialize the payload once and hand the same buffer to every channel
+			var data;
+			if(!isString) {
+				data = RTCHEAP.view(pBuffer, size);
+			} else {
+				data = UTF8ToString(pBuffer, size);
+			}
+			for(var i = 0; i < count; ++i) {
+				var dataChannel = WEBRTC.dataChannelsMap[{{{ makeGetValue('pDcs', 'i*4', 'i32') }}}];
+				var result = -1;
+				if(dataChannel && dataChannel.readyState == 'open') {
+					dataChannel.send(data);
+					result = dataChannel.bufferedAmount;
+				}
+				{{{ makeSetValue('pResults', 'i*' + POINTER_SIZE, 'result', '*') }}};
 			}
 		},
 
-		rtcSetUserPointer: function(i, ptr) {
-			if(WEBRTC.peerConnectionsMap[i]) WEBRTC.peerConnectionsMap[i].rtcUserPointer = ptr;
-			if(WEBRTC.dataChannelsMap[i]) WEBRTC.dataChannelsMap[i].rtcUserPointer = ptr;
+		webrtcSendObject__sig: 'iiipp',
+		webrtcSendObject__deps: ['$RTCOBJECT'],
+		webrtcSendObject: function(dc, object, chunkSize, pTransfer) {
+			if(!dc) return 0;
+			var dataChannel = WEBRTC.dataChannelsMap[dc];
+			if(dataChannel.readyState != 'open') return 0;
+			return RTCOBJECT.transfer(dataChannel, object, chunkSize, pTransfer);
+		},
+
+		webrtcGetTimeline__sig: 'iipi',
+		webrtcGetTimeline: function(pc, pBuffer, count) {
+			var peerConnection = WEBRTC.peerConnectionsMap[pc];
+			if(!peerConnection) return -1;
+			var timeline = peerConnection.rtcTimeline;
+			var n = Math.min(timeline.count, count)*3;
+			for(var i = 0; i < n; ++i)
+				{{{ makeSetValue('pBuffer', 'i*8', 'timeline.entries[i]', 'double') }}};
+			return timeline.count;
+		},
+
+		webrtcGetTimelineLabel__sig: 'iiipp',
+		webrtcGetTimelineLabel: function(pc, index, pBuffer, size) {
+			var peerConnection = WEBRTC.peerConnectionsMap[pc];
+			if(!peerConnection) return -1;
+			var label = peerConnection.rtcTimeline.labels[index];
+			if(label === undefined) return -1;
+			stringToUTF8(label, pBuffer, size);
+			return lengthBytesUTF8(label);
+		},
+
+		webrtcSetUserPointer__sig: 'vip',
+		webrtcSetUserPointer: function(i, ptr) {
+			if(WEBRTC.peerConnectionsMap[i]) WEBRTC.peerConnectionsMap[i].rtcUserPointer = RTCHEAP.ptr(ptr);
+			var dataChannel = WEBRTC.dataChannelsMap[i];
+			if(dataChannel) {
+				dataChannel.rtcUserPointer = RTCHEAP.ptr(ptr);
+				// The channel might already be open, for instance when received from the remote peer
+				if(dataChannel.readyState == 'open') setTimeout(dataChannel.onopen, 0);
+			}
 		},
 	};
 
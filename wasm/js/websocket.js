@@ -22,9 +22,18 @@
 
 (function() {
 	var WebSocket = {
+		$WEBSOCKET__deps: [
+			'wsDispatchOpen',
+			'wsDispatchError',
+			'wsDispatchMessage',
+			'wsDispatchBufferedAmountLow',
+			'$RTCHEAP',
+			'rtcAllocMessageBuffer',
+		],
 		$WEBSOCKET: {
 			map: {},
 			nextId: 1,
+			bufferedAmountPollInterval: 10, // ms
 
 			allocUTF8FromString: function(str) {
 				var strLen = lengthBytesUTF8(str);
@@ -37,114 +46,251 @@
 				var ws = WEBSOCKET.nextId++;
 				WEBSOCKET.map[ws] = webSocket;
 				webSocket.binaryType = 'arraybuffer';
+				webSocket.onopen = function() {
+					if(webSocket.rtcUserDeleted) return;
+					var userPointer = webSocket.rtcUserPointer || 0;
+					if(!userPointer) return;
+					_wsDispatchOpen(ws, userPointer);
+				};
+				webSocket.onerror = function() {
+					if(webSocket.rtcUserDeleted) return;
+					var userPointer = webSocket.rtcUserPointer || 0;
+					if(!userPointer) return;
+					_wsDispatchError(ws, RTCHEAP.ptr(0), userPointer);
+				};
+				webSocket.onmessage = function(evt) {
+					if(webSocket.rtcUserDeleted) return;
+					var userPointer = webSocket.rtcUserPointer || 0;
+					if(!userPointer) return;
+					if(typeof evt.data == 'string') {
+						var str = evt.data;
+						var strLen = lengthBytesUTF8(str);
+						var pStr = RTCHEAP.alloc(strLen+1);
+						stringToUTF8(str, pStr, strLen+1);
+						_wsDispatchMessage(ws, RTCHEAP.ptr(pStr), RTCHEAP.ptr(-(strLen+1)), userPointer);
+					} else {
+						var bytes = new Uint8Array(evt.data);
+						var size = bytes.length;
+						var pBuffer = RTCHEAP.alloc(size);
+						RTCHEAP.write(pBuffer, bytes);
+						_wsDispatchMessage(ws, RTCHEAP.ptr(pBuffer), RTCHEAP.ptr(size), userPointer);
+					}
+				};
+				webSocket.onclose = function() {
+					WEBSOCKET.stopBufferedAmountPolling(webSocket);
+					if(webSocket.rtcUserDeleted) return;
+					var userPointer = webSocket.rtcUserPointer || 0;
+					if(!userPointer) return;
+					_wsDispatchMessage(ws, RTCHEAP.ptr(0), RTCHEAP.ptr(0), userPointer);
+				};
+				webSocket.rtcPollBufferedAmount = function() {
+					webSocket.rtcBufferedAmountTimer = null;
+					if(webSocket.rtcUserDeleted || webSocket.readyState != 1) return;
+					if(webSocket.bufferedAmount > webSocket.rtcBufferedAmountLowThreshold) {
+						webSocket.rtcBufferedAmountTimer =
+							setTimeout(webSocket.rtcPollBufferedAmount, WEBSOCKET.bufferedAmountPollInterval);
+						return;
+					}
+					var userPointer = webSocket.rtcUserPointer || 0;
+					if(!userPointer) return;
+					_wsDispatchBufferedAmountLow(ws, userPointer);
+				};
+				webSocket.rtcId = ws;
+				webSocket.rtcBufferedAmountLowThreshold = 0;
 				return ws;
 			},
+
+			// Browsers have no bufferedamountlow event for WebSockets, so poll bufferedAmount
+			// while it is above the threshold and emulate the event once it drains below.
+			startBufferedAmountPolling: function(webSocket) {
+				if(webSocket.rtcBufferedAmountTimer) return;
+				if(webSocket.bufferedAmount <= webSocket.rtcBufferedAmountLowThreshold) return;
+				webSocket.rtcBufferedAmountTimer =
+					setTimeout(webSocket.rtcPollBufferedAmount, WEBSOCKET.bufferedAmountPollInterval);
+			},
+
+			stopBufferedAmountPolling: function(webSocket) {
+				if(!webSocket.rtcBufferedAmountTimer) return;
+				clearTimeout(webSocket.rtcBufferedAmountTimer);
+				webSocket.rtcBufferedAmountTimer = null;
+			},
+
+			// Wrap a WebSocketStream into an object mimicking the WebSocket interface used above.
+			// Messages are read one at a time, only once the previous one has been dispatched, so
+			// the browser stops reading from the network when the application cannot keep up or
+			// pauses reception, and backpressure propagates to the server.
+			createStreamWebSocket: function(url) {
+				var stream = new WebSocketStream(url);
+				var webSocket = {
+					url: url,
+					readyState: 0,
+					bufferedAmount: 0,
+					rtcStream: stream,
+					rtcWriter: null,
+					rtcReader: null,
+					rtcReading: false,
+					rtcPaused: false,
+				};
+				var closed = function() {
+					if(webSocket.readyState == 3) return;
+					webSocket.readyState = 3;
+					if(webSocket.onclose) webSocket.onclose();
+				};
+				var failed = function() {
+					if(webSocket.readyState == 3) return;
+					if(webSocket.onerror) webSocket.onerror();
+					closed();
+				};
+				webSocket.send = function(data) {
+					if(webSocket.readyState != 1) return;
+					var size;
+					if(typeof data == 'string') {
+						size = lengthBytesUTF8(data);
+					} else {
+						// The write is asynchronous, so the data must not alias the wasm heap
+						data = data.slice();
+						size = data.byteLength;
+					}
+					webSocket.bufferedAmount += size;
+					webSocket.rtcWriter.write(data).then(function() {
+						webSocket.bufferedAmount -= size;
+					}, failed);
+				};
+				webSocket.close = function() {
+					if(webSocket.readyState >= 2) return;
+					webSocket.readyState = 2;
+					stream.close();
+				};
+				webSocket.rtcRead = function() {
+					if(webSocket.rtcReading || webSocket.rtcPaused) return;
+					if(webSocket.readyState != 1) return;
+					webSocket.rtcReading = true;
+					webSocket.rtcReader.read().then(function(result) {
+						webSocket.rtcReading = false;
+						if(result.done) {
+							closed();
+							return;
+						}
+						if(webSocket.onmessage) webSocket.onmessage({data: result.value});
+						webSocket.rtcRead();
+					}, function() {
+						webSocket.rtcReading = false;
+						failed();
+					});
+				};
+				stream.opened.then(function(connection) {
+					if(webSocket.readyState != 0) return;
+					webSocket.readyState = 1;
+					webSocket.rtcWriter = connection.writable.getWriter();
+					webSocket.rtcReader = connection.readable.getReader();
+					if(webSocket.onopen) webSocket.onopen();
+					webSocket.rtcRead();
+				}, failed);
+				stream.closed.then(closed, failed);
+				return webSocket;
+			},
 		},
 
+		wsCreateWebSocket__sig: 'ip',
 		wsCreateWebSocket: function(pUrl) {
 			var url = UTF8ToString(pUrl);
+			if(typeof WebSocketStream != 'undefined')
+				return WEBSOCKET.registerWebSocket(WEBSOCKET.createStreamWebSocket(url));
 			if(!window.WebSocket) return 0;
 			return WEBSOCKET.registerWebSocket(new WebSocket(url));
 		},
 
+		wsDeleteWebSocket__sig: 'vi',
 		wsDeleteWebSocket: function(ws) {
 			var webSocket = WEBSOCKET.map[ws];
 			if(webSocket) {
+				WEBSOCKET.stopBufferedAmountPolling(webSocket);
 				webSocket.close();
 				webSocket.rtcUserDeleted = true;
 				delete WEBSOCKET.map[ws];
 			}
 		},
 
-		wsSetOpenCallback: function(ws, openCallback) {
-			if (!ws) return;
+		wsSendMessage__sig: 'pippi',
+		wsSendMessage: function(ws, pBuffer, size, isString) {
+			if (!ws) return -1;
+			var webSocket = WEBSOCKET.map[ws];
+			if(webSocket.readyState != 1) return -1;
+			if(!isString) {
+				webSocket.send(RTCHEAP.view(pBuffer, size));
+				WEBSOCKET.startBufferedAmountPolling(webSocket);
+				return webSocket.bufferedAmount;
+			} else {
+				var str = UTF8ToString(pBuffer, size);
+				webSocket.send(str);
+				WEBSOCKET.startBufferedAmountPolling(webSocket);
+				return webSocket.bufferedAmount;
+			}
+		},
+
+		wsSendObject__sig: 'iiipp',
+		wsSendObject__deps: ['$RTCOBJECT'],
+		wsSendObject: function(ws, object, chunkSize, pTransfer) {
+			if(!ws) return 0;
 			var webSocket = WEBSOCKET.map[ws];
-			var cb = function() {
-				if(webSocket.rtcUserDeleted) return;
-				var userPointer = webSocket.rtcUserPointer || 0;
-				{{{ makeDynCall('vi', 'openCallback') }}} (userPointer);
-			};
-			webSocket.onopen = cb;
-			if(webSocket.readyState == 1) setTimeout(cb, 0);
+			if(webSocket.readyState != 1) return 0;
+			return RTCOBJECT.transfer(webSocket, object, chunkSize, pTransfer);
 		},
 
- 		wsSetErrorCallback: function(ws, errorCallback) {
-			if (!ws) return;
+		wsGetBufferedAmount__sig: 'pi',
+		wsGetBufferedAmount: function(ws) {
+			if(!ws) return 0;
 			var webSocket = WEBSOCKET.map[ws];
-			var cb = function() {
-				if(webSocket.rtcUserDeleted) return;
-				var userPointer = webSocket.rtcUserPointer || 0;
-        {{{ makeDynCall('vii', 'errorCallback') }}} (0, userPointer);
-			};
-			webSocket.onerror = cb;
+			return webSocket.bufferedAmount;
 		},
 
-		wsSetMessageCallback: function(ws, messageCallback) {
-			if (!ws) return;
+		wsSetBufferedAmountLowThreshold__sig: 'vip',
+		wsSetBufferedAmountLowThreshold: function(ws, threshold) {
+			if(!ws) return;
 			var webSocket = WEBSOCKET.map[ws];
-			webSocket.onmessage = function(evt) {
-				if(webSocket.rtcUserDeleted) return;
-				if(typeof evt.data == 'string') {
-					var pStr = WEBSOCKET.allocUTF8FromString(evt.data);
-					var userPointer = webSocket.rtcUserPointer || 0;
-					{{{ makeDynCall('viii', 'messageCallback') }}} (pStr, -1, userPointer);
-					_free(pStr);
-				} else {
-					var byteArray = new Uint8Array(evt.data);
-					var size = byteArray.byteLength;
-					var pBuffer = _malloc(size);
-					var heapBytes = new Uint8Array(Module['HEAPU8'].buffer, pBuffer, size);
-					heapBytes.set(byteArray);
-					var userPointer = webSocket.rtcUserPointer || 0;
-					{{{ makeDynCall('viii', 'messageCallback') }}} (pBuffer, size, userPointer);
-					_free(pBuffer);
-				}
-			};
-			webSocket.onclose = function() {
-				if(webSocket.rtcUserDeleted) return;
-				var userPointer = webSocket.rtcUserPointer || 0;
-				{{{ makeDynCall('viii', 'messageCallback') }}} (0, 0, userPointer);
-			};
+			webSocket.rtcBufferedAmountLowThreshold = threshold;
+			WEBSOCKET.startBufferedAmountPolling(webSocket);
 		},
 
-		wsSendMessage: function(ws, pBuffer, size) {
-			if (!ws) return -1;
+		wsSetReceivePaused__sig: 'vii',
+		wsSetReceivePaused: function(ws, paused) {
+			if(!ws) return;
 			var webSocket = WEBSOCKET.map[ws];
-			if(webSocket.readyState != 1) return -1;
-			if(size >= 0) {
-				var heapBytes = new Uint8Array(Module['HEAPU8'].buffer, pBuffer, size);
-				if(heapBytes.buffer instanceof ArrayBuffer) {
-					webSocket.send(heapBytes);
-				} else {
-					var byteArray = new Uint8Array(new ArrayBuffer(size));
-					byteArray.set(heapBytes);
-					webSocket.send(byteArray);
-				}
-				return size;
-			} else {
-				var str = UTF8ToString(pBuffer);
-				webSocket.send(str);
-				return lengthBytesUTF8(str);
-			}
+			if(!webSocket.rtcStream) return; // Unsupported by the classic WebSocket
+			webSocket.rtcPaused = !!paused;
+			if(!webSocket.rtcPaused) webSocket.rtcRead();
+		},
+
+		wsIsStreamBackend__sig: 'ii',
+		wsIsStreamBackend: function(ws) {
+			if(!ws) return 0;
+			var webSocket = WEBSOCKET.map[ws];
+			return webSocket.rtcStream ? 1 : 0;
 		},
 
+		wsGetWebSocketUrl__sig: 'pi',
 		wsGetWebSocketUrl: function(ws) {
 			if(!ws) return 0;
 			var webSocket = WEBSOCKET.map[ws];
-			var url = WEBRTC.allocUTF8FromString(webSocket.url);
+			var url = WEBSOCKET.allocUTF8FromString(webSocket.url);
 			// url should be freed later in c++.
 			return url;
 		},
 
+		wsGetWebSocketState__sig: 'ii',
 		wsGetWebSocketState: function(ws) {
 			if(!ws) return WebSocket.CLOSED;
 			var webSocket = WEBSOCKET.map[ws];
 			return webSocket.readyState;
 		},
 
+		wsSetUserPointer__sig: 'vip',
 		wsSetUserPointer: function(ws, ptr) {
 			var webSocket = WEBSOCKET.map[ws];
-			if(webSocket) webSocket.rtcUserPointer = ptr;
+			if(webSocket) {
+				webSocket.rtcUserPointer = RTCHEAP.ptr(ptr);
+				if(webSocket.readyState == 1) setTimeout(webSocket.onopen, 0);
+			}
 		},
 	};
 
@@ -0,0 +1,312 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bondedchannel.hpp"
+#include "log.hpp"
+
+#include <emscripten/emscripten.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace rtc {
+
+namespace {
+
+// Frames are prefixed with a flags byte and the sequence number in network byte order
+const size_t HeaderSize = 5;
+const uint8_t StringFlag = 0x01;
+
+MessageBuffer makeFrame(uint32_t seq, bool isString, const byte *data, size_t size) {
+	MessageBuffer frame(HeaderSize + size);
+	byte *p = frame.data();
+	p[0] = byte(isString ? StringFlag : 0);
+	p[1] = byte(seq >> 24);
+	p[2] = byte(seq >> 16);
+	p[3] = byte(seq >> 8);
+	p[4] = byte(seq);
+	std::copy(data, data + size, p + HeaderSize);
+	return frame;
+}
+
+uint32_t readSeq(const byte *p) {
+	return uint32_t(std::to_integer<uint8_t>(p[1])) << 24 |
+	       uint32_t(std::to_integer<uint8_t>(p[2])) << 16 |
+	       uint32_t(std::to_integer<uint8_t>(p[3])) << 8 | uint32_t(std::to_integer<uint8_t>(p[4]));
+}
+
+} // namespace
+
+BondedChannel::BondedChannel(std::vector<BondPath> paths, BondInit init)
+    : mPaths(std::move(paths)), mInit(std::move(init)) {
+	if (mPaths.empty())
+		RTC_THROW(std::invalid_argument, "BondedChannel requires at least one path");
+
+	// Like the mux, the bond takes over the channel callbacks and resets them on destruction
+	for (const auto &path : mPaths) {
+		if (!path.channel)
+			RTC_THROW(std::invalid_argument, "BondedChannel path requires a channel");
+
+		auto &channel = path.channel;
+		channel->onOpen([this]() { triggerPathOpen(); });
+		channel->onClosed([this]() { triggerPathClosed(); });
+		channel->onError([this](string error) { triggerError(std::move(error)); });
+		channel->onMessageBuffer(
+		    [this](MessageBuffer frame) { triggerPathMessage(std::move(frame)); });
+		channel->onBufferedAmountLow([this]() { triggerPathBufferedAmountLow(); });
+	}
+
+	// Paths already open do not call back, so open the bond once callbacks can be set
+	mSelf = std::make_shared<BondedChannel *>(this);
+	if (isOpen())
+		emscripten_async_call(TriggerOpen, new std::weak_ptr<BondedChannel *>(mSelf), 0);
+}
+
+BondedChannel::~BondedChannel() {
+	for (const auto &path : mPaths) {
+		auto &channel = path.channel;
+		channel->onOpen(nullptr);
+		channel->onClosed(nullptr);
+		channel->onError(nullptr);
+		channel->onMessageBuffer(nullptr);
+		channel->onBufferedAmountLow(nullptr);
+	}
+}
+
+void BondedChannel::close() {
+	for (const auto &path : mPaths)
+		path.channel->close();
+
+	// Channels closed locally do not call back
+	triggerPathClosed();
+}
+
+bool BondedChannel::send(message_variant data) {
+	return std::visit(overloaded{[this](const binary &b) {
+		                             captureSend(b.data(), b.size(), false);
+		                             return sendFrame(makeFrame(mNextSeq++, false, b.data(),
+		                                                        b.size()));
+	                             },
+	                             [this](const string &s) {
+		                             auto b = reinterpret_cast<const byte *>(s.data());
+		                             captureSend(b, s.size(), true);
+		                             return sendFrame(makeFrame(mNextSeq++, true, b, s.size()));
+	                             }},
+	                  std::move(data));
+}
+
+bool BondedChannel::send(const byte *data, size_t size) {
+	captureSend(data, size, false);
+	return sendFrame(makeFrame(mNextSeq++, false, data, size));
+}
+
+bool BondedChannel::send(const MessageBuffer &data) {
+	captureSend(data.data(), data.size(), data.isString());
+	return sendFrame(makeFrame(mNextSeq++, data.isString(), data.data(), data.size()));
+}
+
+bool BondedChannel::isOpen() const {
+	return std::any_of(mPaths.begin(), mPaths.end(),
+	                   [](const BondPath &path) { return path.channel->isOpen(); });
+}
+
+bool BondedChannel::isClosed() const {
+	return std::all_of(mPaths.begin(), mPaths.end(),
+	                   [](const BondPath &path) { return path.channel->isClosed(); });
+}
+
+size_t BondedChannel::bufferedAmount() const {
+	if (mInit.mode == BondMode::Fastest && mActivePath && isUsable(*mActivePath))
+		return mPaths[*mActivePath].channel->bufferedAmount();
+
+	size_t amount = std::numeric_limits<size_t>::max();
+	for (const auto &path : mPaths)
+		if (path.channel->isOpen())
+			amount = std::min(amount, path.channel->bufferedAmount());
+
+	return amount != std::numeric_limits<size_t>::max() ? amount : 0;
+}
+
+BondMode BondedChannel::mode() const { return mInit.mode; }
+
+void BondedChannel::setMode(BondMode mode) { mInit.mode = mode; }
+
+optional<size_t> BondedChannel::activePath() const { return mActivePath; }
+
+void BondedChannel::setBufferedAmountLowThreshold(size_t amount) {
+	mBufferedAmountLowThreshold = amount;
+	for (const auto &path : mPaths)
+		path.channel->setBufferedAmountLowThreshold(amount);
+}
+
+bool BondedChannel::sendFrame(const MessageBuffer &frame) {
+	if (mInit.mode == BondMode::Redundant) {
+		// Hand the frame to every path with a single call, skipping backed up paths unless
+		// all of them are
+		std::vector<shared_ptr<DataChannel>> channels;
+		std::vector<shared_ptr<DataChannel>> backedUp;
+		for (const auto &path : mPaths) {
+			if (!path.channel->isOpen())
+				continue;
+
+			if (path.channel->bufferedAmount() > mInit.maxPathBufferedAmount)
+				backedUp.push_back(path.channel);
+			else
+				channels.push_back(path.channel);
+		}
+
+		auto results = broadcast(channels.empty() ? backedUp : channels, frame.data(),
+		                         frame.size());
+		return std::find(results.begin(), results.end(), true) != results.end();
+	}
+
+	auto selected = selectPath();
+	if (!selected)
+		return false;
+
+	if (mPaths[*selected].channel->send(frame))
+		return true;
+
+	for (size_t i = 0; i < mPaths.size(); ++i)
+		if (i != *selected && mPaths[i].channel->isOpen() && mPaths[i].channel->send(frame))
+			return true;
+
+	return false;
+}
+
+bool BondedChannel::isUsable(size_t index) const {
+	const auto &path = mPaths[index];
+	return path.channel->isOpen() &&
+	       (!path.peerConnection || path.peerConnection->isPeerResponsive());
+}
+
+optional<size_t> BondedChannel::selectPath() {
+	using std::chrono::microseconds;
+	auto rtt = [this](size_t index) {
+		auto &pc = mPaths[index].peerConnection;
+		auto value = pc ? pc->roundTripTime() : std::nullopt;
+		return value.value_or(microseconds::max());
+	};
+
+	// Paths without a measured round-trip time come last, in the order they were given
+	optional<size_t> best;
+	for (size_t i = 0; i < mPaths.size(); ++i)
+		if (isUsable(i) && (!best || rtt(i) < rtt(*best)))
+			best = i;
+
+	if (!best) {
+		// No path is known to be responsive, try any open one
+		for (size_t i = 0; i < mPaths.size() && !best; ++i)
+			if (mPaths[i].channel->isOpen())
+				best = i;
+
+		return best;
+	}
+
+	// Switching paths may reorder messages, so only leave a usable path for a clearly faster one
+	if (mActivePath && *mActivePath != *best && isUsable(*mActivePath)) {
+		auto current = rtt(*mActivePath);
+		if (current != microseconds::max() && rtt(*best) * 4 >= current * 3)
+			return mActivePath;
+	}
+
+	if (mActivePath != best) {
+		RTC_LOG_INFO("Bond switching to path ", *best);
+		mActivePath = best;
+	}
+	return best;
+}
+
+bool BondedChannel::accept(uint32_t seq) {
+	auto slot = [](uint32_t s) { return size_t(s % ReceiveWindow); };
+	if (!mHighestSeq) {
+		mHighestSeq = seq;
+		mReceived.set(slot(seq));
+		return true;
+	}
+
+	// Serial number arithmetic, so that sequence numbers may wrap around
+	auto diff = int32_t(seq - *mHighestSeq);
+	if (diff > 0) {
+		if (size_t(diff) >= ReceiveWindow)
+			mReceived.reset();
+		else
+			for (uint32_t s = *mHighestSeq + 1; s != seq; ++s)
+				mReceived.reset(slot(s));
+
+		mHighestSeq = seq;
+		mReceived.set(slot(seq));
+		return true;
+	}
+
+	if (size_t(-int64_t(diff)) >= ReceiveWindow || mReceived.test(slot(seq)))
+		return false;
+
+	mReceived.set(slot(seq));
+	return true;
+}
+
+void BondedChannel::TriggerOpen(void *arg) {
+	std::unique_ptr<std::weak_ptr<BondedChannel *>> weak(
+	    static_cast<std::weak_ptr<BondedChannel *> *>(arg));
+	if (auto self = weak->lock())
+		if ((*self)->isOpen())
+			(*self)->triggerPathOpen();
+}
+
+void BondedChannel::triggerPathOpen() {
+	if (!mOpen) {
+		mOpen = true;
+		mClosed = false;
+		triggerOpen();
+	}
+}
+
+void BondedChannel::triggerPathClosed() {
+	if (!mClosed && isClosed()) {
+		mClosed = true;
+		mOpen = false;
+		triggerClosed();
+	}
+}
+
+void BondedChannel::triggerPathMessage(MessageBuffer frame) {
+	if (frame.isString() || frame.size() < HeaderSize)
+		return;
+
+	const byte *p = frame.data();
+	if (!accept(readSeq(p)))
+		return;
+
+	using Type = MessageBuffer::Type;
+	bool isString = (std::to_integer<uint8_t>(p[0]) & StringFlag) != 0;
+	triggerMessageBuffer(MessageBuffer(p + HeaderSize, frame.size() - HeaderSize,
+	                                   isString ? Type::String : Type::Binary));
+}
+
+void BondedChannel::triggerPathBufferedAmountLow() {
+	if (bufferedAmount() <= mBufferedAmountLowThreshold)
+		triggerBufferedAmountLow();
+}
+
+} // namespace rtc
@@ -22,19 +22,171 @@
 
 #include "candidate.hpp"
 
+#include <cstring>
+
+namespace {
+
+bool equals(const std::string &str, size_t pos, size_t len, const char *value) {
+	return len == std::strlen(value) && str.compare(pos, len, value) == 0;
+}
+
+std::optional<uint64_t> parseNumber(const std::string &str, size_t pos, size_t len) {
+	if (len == 0 || len > 10)
+		return std::nullopt;
+
+	uint64_t value = 0;
+	for (size_t i = pos; i < pos + len; ++i) {
+		if (str[i] < '0' || str[i] > '9')
+			return std::nullopt;
+		value = value * 10 + uint64_t(str[i] - '0');
+	}
+	return value;
+}
+
+} // namespace
+
 namespace rtc {
 
 Candidate::Candidate(const string &candidate, const string &mid)
     : mCandidate(candidate), mMid(mid) {}
 
-string Candidate::candidate() const { return mCandidate; }
+const string &Candidate::candidate() const { return mCandidate; }
 
-string Candidate::mid() const { return mMid; }
+const string &Candidate::mid() const { return mMid; }
 
 Candidate::operator string() const { return "a=" + mCandidate; }
 
+string Candidate::foundation() const { return substr(fields().foundation).value_or(""); }
+
+uint32_t Candidate::component() const { return fields().component; }
+
+Candidate::TransportType Candidate::transportType() const { return fields().transportType; }
+
+uint32_t Candidate::priority() const { return fields().priority; }
+
+optional<string> Candidate::address() const { return substr(fields().address); }
+
+optional<uint16_t> Candidate::port() const { return fields().port; }
+
+Candidate::Family Candidate::family() const {
+	const Span &span = fields().address;
+	if (span.len == 0)
+		return Family::Unresolved;
+
+	// Hostnames, for instance mDNS names, are left unresolved
+	bool ipv4 = true;
+	for (size_t i = span.pos; i < span.pos + span.len; ++i) {
+		char c = mCandidate[i];
+		if (c == ':')
+			return Family::Ipv6;
+		if (c != '.' && (c < '0' || c > '9'))
+			ipv4 = false;
+	}
+	return ipv4 ? Family::Ipv4 : Family::Unresolved;
+}
+
+Candidate::Type Candidate::type() const { return fields().type; }
+
+optional<string> Candidate::relatedAddress() const { return substr(fields().relatedAddress); }
+
+optional<uint16_t> Candidate::relatedPort() const { return fields().relatedPort; }
+
+const Candidate::Fields &Candidate::fields() const {
+	if (mFields)
+		return *mFields;
+
+	// candidate:<foundation> <component> <transport> <priority> <address> <port> typ <type>
+	//           [raddr <address>] [rport <port>] [tcptype <tcptype>] ...
+	Fields &f = mFields.emplace();
+	const string &s = mCandidate;
+	size_t pos = 0;
+	if (s.compare(0, 2, "a=") == 0)
+		pos = 2;
+	if (s.compare(pos, 10, "candidate:") == 0)
+		pos += 10;
+
+	bool tcp = false;
+	Span key;
+	for (size_t index = 0; pos < s.size(); ++index) {
+		size_t end = s.find(' ', pos);
+		if (end == string::npos)
+			end = s.size();
+
+		Span token{pos, end - pos};
+		pos = end + 1;
+		switch (index) {
+		case 0:
+			f.foundation = token;
+			break;
+		case 1:
+			f.component = uint32_t(parseNumber(s, token.pos, token.len).value_or(0));
+			break;
+		case 2:
+			if (equals(s, token.pos, token.len, "UDP") || equals(s, token.pos, token.len, "udp"))
+				f.transportType = TransportType::Udp;
+			else if (equals(s, token.pos, token.len, "TCP") ||
+			         equals(s, token.pos, token.len, "tcp"))
+				tcp = true;
+			break;
+		case 3:
+			f.priority = uint32_t(parseNumber(s, token.pos, token.len).value_or(0));
+			break;
+		case 4:
+			f.address = token;
+			break;
+		case 5:
+			if (auto port = parseNumber(s, token.pos, token.len); port && *port <= 0xFFFF)
+				f.port = uint16_t(*port);
+			break;
+		default:
+			// Remaining tokens are key-value pairs, starting with typ
+			if (index % 2 == 0) {
+				key = token;
+				break;
+			}
+			if (equals(s, key.pos, key.len, "typ")) {
+				if (equals(s, token.pos, token.len, "host"))
+					f.type = Type::Host;
+				else if (equals(s, token.pos, token.len, "srflx"))
+					f.type = Type::ServerReflexive;
+				else if (equals(s, token.pos, token.len, "prflx"))
+					f.type = Type::PeerReflexive;
+				else if (equals(s, token.pos, token.len, "relay"))
+					f.type = Type::Relayed;
+			} else if (equals(s, key.pos, key.len, "raddr")) {
+				f.relatedAddress = token;
+			} else if (equals(s, key.pos, key.len, "rport")) {
+				if (auto port = parseNumber(s, token.pos, token.len); port && *port <= 0xFFFF)
+					f.relatedPort = uint16_t(*port);
+			} else if (equals(s, key.pos, key.len, "tcptype") && tcp) {
+				if (equals(s, token.pos, token.len, "active"))
+					f.transportType = TransportType::TcpActive;
+				else if (equals(s, token.pos, token.len, "passive"))
+					f.transportType = TransportType::TcpPassive;
+				else if (equals(s, token.pos, token.len, "so"))
+					f.transportType = TransportType::TcpSo;
+			}
+			break;
+		}
+	}
+
+	if (tcp && f.transportType == TransportType::Unknown)
+		f.transportType = TransportType::TcpUnknown;
+
+	return f;
+}
+
+optional<string> Candidate::substr(Span span) const {
+	if (span.len == 0)
+		return std::nullopt;
+
+	return mCandidate.substr(span.pos, span.len);
+}
+
 } // namespace rtc
 
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, const rtc::Candidate &candidate) {
 	return out << std::string(candidate);
 }
+#endif
@@ -0,0 +1,229 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "capi.hpp"
+#include "global.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <vector>
+
+namespace rtc::capi {
+
+namespace {
+
+// Handles indexed by id minus one, with the slots of deleted handles reused
+std::vector<std::unique_ptr<Handle>> Handles;
+std::vector<int> FreeIds;
+
+rtcLogCallbackFunc LoggerCallback = nullptr;
+
+Handle *GetChannel(int id) {
+	Handle *h = GetHandle(id);
+	return h && h->kind != Handle::Kind::PeerConnection ? h : nullptr;
+}
+
+} // namespace
+
+Handle *CreateHandle(Handle::Kind kind, int glueId, const Ops *ops) {
+	int id;
+	if (!FreeIds.empty()) {
+		id = FreeIds.back();
+		FreeIds.pop_back();
+	} else {
+		Handles.emplace_back();
+		id = int(Handles.size());
+	}
+
+	auto &handle = Handles[id - 1];
+	handle = std::make_unique<Handle>();
+	handle->kind = kind;
+	handle->id = id;
+	handle->glueId = glueId;
+	handle->ops = ops;
+	return handle.get();
+}
+
+Handle *GetHandle(int id) {
+	if (id <= 0 || size_t(id) > Handles.size())
+		return nullptr;
+
+	return Handles[id - 1].get();
+}
+
+void DestroyHandle(Handle *handle) {
+	int id = handle->id;
+	Handles[id - 1].reset();
+	FreeIds.push_back(id);
+}
+
+} // namespace rtc::capi
+
+using rtc::capi::GetChannel;
+using rtc::capi::GetHandle;
+using rtc::capi::Handle;
+
+void rtcInitLogger(rtcLogLevel level, rtcLogCallbackFunc cb) {
+	rtc::capi::LoggerCallback = cb;
+	rtc::LogCallback callback;
+	if (cb)
+		callback = [](rtc::LogLevel level, rtc::string message) {
+			if (rtc::capi::LoggerCallback)
+				rtc::capi::LoggerCallback(static_cast<rtcLogLevel>(level), message.c_str());
+		};
+
+	rtc::InitLogger(static_cast<rtc::LogLevel>(level), std::move(callback));
+}
+
+void rtcSetUserPointer(int id, void *ptr) {
+	if (Handle *h = GetHandle(id))
+		h->user = ptr;
+}
+
+void *rtcGetUserPointer(int id) {
+	Handle *h = GetHandle(id);
+	return h ? h->user : nullptr;
+}
+
+int rtcClose(int id) {
+	Handle *h = GetChannel(id);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->open = false;
+	h->closed = true;
+	if (h->glueId) {
+		h->ops->remove(h->glueId);
+		h->glueId = 0;
+	}
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcDelete(int id) {
+	Handle *h = GetChannel(id);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	rtcClose(id);
+	rtc::capi::DestroyHandle(h);
+	return RTC_ERR_SUCCESS;
+}
+
+bool rtcIsOpen(int id) {
+	Handle *h = GetChannel(id);
+	return h && h->open;
+}
+
+bool rtcIsClosed(int id) {
+	Handle *h = GetChannel(id);
+	return !h || h->closed;
+}
+
+int rtcSetOpenCallback(int id, rtcOpenCallbackFunc cb) {
+	Handle *h = GetChannel(id);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->openCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetClosedCallback(int id, rtcClosedCallbackFunc cb) {
+	Handle *h = GetChannel(id);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->closedCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetErrorCallback(int id, rtcErrorCallbackFunc cb) {
+	Handle *h = GetChannel(id);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->errorCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetMessageCallback(int id, rtcMessageCallbackFunc cb) {
+	Handle *h = GetChannel(id);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->messageCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetBufferedAmountLowCallback(int id, rtcBufferedAmountLowCallbackFunc cb) {
+	Handle *h = GetChannel(id);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->bufferedAmountLowCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSendMessage(int id, const char *data, int size) {
+	Handle *h = GetChannel(id);
+	if (!h || (!data && size != 0))
+		return RTC_ERR_INVALID;
+
+	if (!h->glueId || h->closed)
+		return RTC_ERR_FAILURE;
+
+	// The data is passed as-is to the glue, which copies it
+	bool isString = size < 0;
+	size_t length = isString ? std::strlen(data) : size_t(size);
+	if (h->ops->send(h->glueId, data, length, isString ? 1 : 0) < 0)
+		return RTC_ERR_FAILURE;
+
+	return int(length);
+}
+
+int rtcGetBufferedAmount(int id) {
+	Handle *h = GetChannel(id);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	if (!h->glueId)
+		return 0;
+
+	ptrdiff_t amount = h->ops->bufferedAmount(h->glueId);
+	return int(std::clamp(amount, ptrdiff_t(0), ptrdiff_t(INT_MAX)));
+}
+
+int rtcSetBufferedAmountLowThreshold(int id, int amount) {
+	Handle *h = GetChannel(id);
+	if (!h || amount < 0)
+		return RTC_ERR_INVALID;
+
+	if (h->glueId)
+		h->ops->setBufferedAmountLowThreshold(h->glueId, size_t(amount));
+
+	return RTC_ERR_SUCCESS;
+}
+
+void rtcPreload() {}
+
+void rtcCleanup() {}
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_CAPI_H
+#define RTC_CAPI_H
+
+#include "message.hpp"
+#include "rtc.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace rtc::capi {
+
+// Glue functions of a kind of channel, whose signatures are the same for data channels and
+// WebSockets
+struct Ops {
+	void (*remove)(int id);
+	ptrdiff_t (*send)(int id, const char *buffer, size_t size, int isString);
+	ptrdiff_t (*bufferedAmount)(int id);
+	void (*setBufferedAmountLowThreshold)(int id, size_t threshold);
+};
+
+struct Handle {
+	enum class Kind { PeerConnection, DataChannel, WebSocket };
+
+	Kind kind;
+	int id = 0;     // Public id, in a single space for all kinds
+	int glueId = 0; // Id in the glue, zero once deleted from it
+	const Ops *ops; // For a peer connection, the operations of its data channels
+	void *user = nullptr;
+	bool open = false;
+	bool closed = false;
+
+	rtcOpenCallbackFunc openCallback = nullptr;
+	rtcClosedCallbackFunc closedCallback = nullptr;
+	rtcErrorCallbackFunc errorCallback = nullptr;
+	rtcMessageCallbackFunc messageCallback = nullptr;
+	rtcBufferedAmountLowCallbackFunc bufferedAmountLowCallback = nullptr;
+
+	rtcDescriptionCallbackFunc localDescriptionCallback = nullptr;
+	rtcCandidateCallbackFunc localCandidateCallback = nullptr;
+	rtcStateChangeCallbackFunc stateChangeCallback = nullptr;
+	rtcIceStateChangeCallbackFunc iceStateChangeCallback = nullptr;
+	rtcGatheringStateCallbackFunc gatheringStateCallback = nullptr;
+	rtcSignalingStateCallbackFunc signalingStateCallback = nullptr;
+	rtcDataChannelCallbackFunc dataChannelCallback = nullptr;
+};
+
+Handle *CreateHandle(Handle::Kind kind, int glueId, const Ops *ops);
+Handle *GetHandle(int id);
+void DestroyHandle(Handle *handle);
+
+// Handles are registered with the glue as user pointers with the low bit set, which is always
+// clear for the C++ objects, so the dispatch functions can tell them apart
+inline void *ToUserPointer(Handle *handle) {
+	return reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(handle) | 1);
+}
+
+inline Handle *FromUserPointer(void *ptr) {
+	auto value = reinterpret_cast<uintptr_t>(ptr);
+	return value & 1 ? reinterpret_cast<Handle *>(value & ~uintptr_t(1)) : nullptr;
+}
+
+inline void DispatchOpen(Handle *h) {
+	h->open = true;
+	if (h->openCallback)
+		h->openCallback(h->id, h->user);
+}
+
+// The channel is kept in the glue until deleted so that its properties remain available
+inline void DispatchClosed(Handle *h) {
+	h->open = false;
+	h->closed = true;
+	if (h->closedCallback)
+		h->closedCallback(h->id, h->user);
+}
+
+inline void DispatchError(Handle *h, const char *error) {
+	if (h->errorCallback)
+		h->errorCallback(h->id, error ? error : "unknown", h->user);
+}
+
+inline void DispatchMessage(Handle *h, const MessageBuffer &buffer) {
+	if (!h->messageCallback)
+		return;
+
+	// String buffers are allocated with a null terminator
+	const char *data = reinterpret_cast<const char *>(buffer.data());
+	int size = buffer.isString() ? -int(buffer.size() + 1) : int(buffer.size());
+	h->messageCallback(h->id, data, size, h->user);
+}
+
+inline void DispatchBufferedAmountLow(Handle *h) {
+	if (h->bufferedAmountLowCallback)
+		h->bufferedAmountLowCallback(h->id, h->user);
+}
+
+} // namespace rtc::capi
+
+#endif // RTC_CAPI_H
@@ -0,0 +1,374 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "capi.hpp"
+#include "datachannel.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+extern int webrtcCreatePeerConnection(const char **pUrls, const char **pUsernames,
+                                      const char **pPasswords, int nIceServers,
+                                      bool timelineMarks);
+extern void webrtcDeletePeerConnection(int pc);
+extern char *webrtcGetLocalDescription(int pc);
+extern char *webrtcGetLocalDescriptionType(int pc);
+extern char *webrtcGetRemoteDescription(int pc);
+extern char *webrtcGetRemoteDescriptionType(int pc);
+extern int webrtcCreateDataChannel(int pc, const char *label, bool unordered,
+                                   int maxRetransmits, int maxPacketLifeTime, int priority,
+                                   int id);
+extern void webrtcDeleteDataChannel(int dc);
+extern void webrtcSetRemoteDescription(int pc, const char *sdp, const char *type);
+extern void webrtcAddRemoteCandidate(int pc, const char *candidate, const char *mid);
+extern int webrtcGetDataChannelLabel(int dc, char *buffer, size_t size);
+extern int webrtcGetDataChannelUnordered(int dc);
+extern int webrtcGetDataChannelMaxPacketLifeTime(int dc);
+extern int webrtcGetDataChannelMaxRetransmits(int dc);
+extern ptrdiff_t webrtcGetBufferedAmount(int dc);
+extern void webrtcSetBufferedAmountLowThreshold(int dc, size_t threshold);
+extern ptrdiff_t webrtcSendMessage(int dc, const char *buffer, size_t size, int isString);
+extern void webrtcSetUserPointer(int i, void *ptr);
+}
+
+namespace {
+
+using rtc::capi::GetHandle;
+using rtc::capi::Handle;
+using std::string;
+
+const rtc::capi::Ops DataChannelOps = {
+    webrtcDeleteDataChannel,
+    webrtcSendMessage,
+    webrtcGetBufferedAmount,
+    webrtcSetBufferedAmountLowThreshold,
+};
+
+Handle *GetPeerConnection(int pc) {
+	Handle *h = GetHandle(pc);
+	return h && h->kind == Handle::Kind::PeerConnection ? h : nullptr;
+}
+
+Handle *GetDataChannel(int dc) {
+	Handle *h = GetHandle(dc);
+	return h && h->kind == Handle::Kind::DataChannel ? h : nullptr;
+}
+
+// Browsers expect the credentials of "turn:username:password@hostname:port" separately
+void SplitIceServer(const string &str, string &url, string &username, string &password) {
+	size_t colon = str.find(':');
+	size_t at = str.rfind('@');
+	if (colon == string::npos || at == string::npos || at < colon) {
+		url = str;
+		return;
+	}
+
+	string credentials = str.substr(colon + 1, at - colon - 1);
+	size_t separator = credentials.find(':');
+	username = credentials.substr(0, separator);
+	if (separator != string::npos)
+		password = credentials.substr(separator + 1);
+
+	url = str.substr(0, colon + 1) + str.substr(at + 1);
+}
+
+// Copy a string allocated by the glue to the buffer of the caller, then free it
+int CopyAndFree(char *str, char *buffer, int size) {
+	if (!str)
+		return RTC_ERR_NOT_AVAIL;
+
+	int length = int(std::strlen(str)) + 1;
+	int ret = length;
+	if (buffer) {
+		if (size >= length)
+			std::memcpy(buffer, str, size_t(length));
+		else
+			ret = RTC_ERR_TOO_SMALL;
+	}
+	free(str);
+	return ret;
+}
+
+} // namespace
+
+int rtcCreatePeerConnection(const rtcConfiguration *config) {
+	if (!config || config->iceServersCount < 0 || (!config->iceServers && config->iceServersCount))
+		return RTC_ERR_INVALID;
+
+	size_t count = size_t(config->iceServersCount);
+	std::vector<string> urls(count), usernames(count), passwords(count);
+	std::vector<const char *> url_ptrs, username_ptrs, password_ptrs;
+	url_ptrs.reserve(count);
+	username_ptrs.reserve(count);
+	password_ptrs.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		if (!config->iceServers[i])
+			return RTC_ERR_INVALID;
+
+		SplitIceServer(config->iceServers[i], urls[i], usernames[i], passwords[i]);
+		url_ptrs.push_back(urls[i].c_str());
+		username_ptrs.push_back(usernames[i].c_str());
+		password_ptrs.push_back(passwords[i].c_str());
+	}
+
+	int glueId = webrtcCreatePeerConnection(url_ptrs.data(), username_ptrs.data(),
+	                                        password_ptrs.data(), int(count), false);
+	if (!glueId)
+		return RTC_ERR_FAILURE;
+
+	Handle *h = rtc::capi::CreateHandle(Handle::Kind::PeerConnection, glueId, &DataChannelOps);
+	webrtcSetUserPointer(glueId, rtc::capi::ToUserPointer(h));
+	return h->id;
+}
+
+int rtcClosePeerConnection(int pc) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	if (h->glueId) {
+		webrtcDeletePeerConnection(h->glueId);
+		h->glueId = 0;
+	}
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcDeletePeerConnection(int pc) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	rtcClosePeerConnection(pc);
+	rtc::capi::DestroyHandle(h);
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetLocalDescriptionCallback(int pc, rtcDescriptionCallbackFunc cb) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->localDescriptionCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetLocalCandidateCallback(int pc, rtcCandidateCallbackFunc cb) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->localCandidateCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetStateChangeCallback(int pc, rtcStateChangeCallbackFunc cb) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->stateChangeCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetIceStateChangeCallback(int pc, rtcIceStateChangeCallbackFunc cb) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->iceStateChangeCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetGatheringStateChangeCallback(int pc, rtcGatheringStateCallbackFunc cb) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->gatheringStateCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetSignalingStateChangeCallback(int pc, rtcSignalingStateCallbackFunc cb) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->signalingStateCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcSetRemoteDescription(int pc, const char *sdp, const char *type) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h || !sdp || !type)
+		return RTC_ERR_INVALID;
+
+	if (!h->glueId)
+		return RTC_ERR_FAILURE;
+
+	webrtcSetRemoteDescription(h->glueId, sdp, type);
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcAddRemoteCandidate(int pc, const char *cand, const char *mid) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h || !cand)
+		return RTC_ERR_INVALID;
+
+	if (!h->glueId)
+		return RTC_ERR_FAILURE;
+
+	webrtcAddRemoteCandidate(h->glueId, cand, mid ? mid : "");
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcGetLocalDescription(int pc, char *buffer, int size) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	return CopyAndFree(h->glueId ? webrtcGetLocalDescription(h->glueId) : nullptr, buffer, size);
+}
+
+int rtcGetRemoteDescription(int pc, char *buffer, int size) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	return CopyAndFree(h->glueId ? webrtcGetRemoteDescription(h->glueId) : nullptr, buffer, size);
+}
+
+int rtcGetLocalDescriptionType(int pc, char *buffer, int size) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	return CopyAndFree(h->glueId ? webrtcGetLocalDescriptionType(h->glueId) : nullptr, buffer,
+	                   size);
+}
+
+int rtcGetRemoteDescriptionType(int pc, char *buffer, int size) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	return CopyAndFree(h->glueId ? webrtcGetRemoteDescriptionType(h->glueId) : nullptr, buffer,
+	                   size);
+}
+
+int rtcSetDataChannelCallback(int pc, rtcDataChannelCallbackFunc cb) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	h->dataChannelCallback = cb;
+	return RTC_ERR_SUCCESS;
+}
+
+int rtcCreateDataChannel(int pc, const char *label) {
+	return rtcCreateDataChannelEx(pc, label, nullptr);
+}
+
+int rtcCreateDataChannelEx(int pc, const char *label, const rtcDataChannelInit *init) {
+	Handle *h = GetPeerConnection(pc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	// Browsers only accept an id for a negotiated channel, which requires one
+	if (init && init->negotiated && !init->manualStream)
+		return RTC_ERR_INVALID;
+
+	if (!h->glueId)
+		return RTC_ERR_FAILURE;
+
+	bool unordered = false;
+	int maxRetransmits = -1;
+	int maxPacketLifeTime = -1;
+	int id = -1;
+	if (init) {
+		const rtcReliability &reliability = init->reliability;
+		unordered = reliability.unordered;
+		if (reliability.unreliable) {
+			if (reliability.maxPacketLifeTime > 0)
+				maxPacketLifeTime = int(reliability.maxPacketLifeTime);
+			else
+				maxRetransmits = int(reliability.maxRetransmits);
+		}
+		if (init->negotiated)
+			id = int(init->stream);
+	}
+
+	int glueId = webrtcCreateDataChannel(h->glueId, label ? label : "", unordered,
+	                                     maxRetransmits, maxPacketLifeTime,
+	                                     int(rtc::Priority::Low), id);
+	if (!glueId)
+		return RTC_ERR_FAILURE;
+
+	Handle *d = rtc::capi::CreateHandle(Handle::Kind::DataChannel, glueId, h->ops);
+	webrtcSetUserPointer(glueId, rtc::capi::ToUserPointer(d));
+	return d->id;
+}
+
+int rtcDeleteDataChannel(int dc) {
+	if (!GetDataChannel(dc))
+		return RTC_ERR_INVALID;
+
+	return rtcDelete(dc);
+}
+
+int rtcGetDataChannelLabel(int dc, char *buffer, int size) {
+	Handle *h = GetDataChannel(dc);
+	if (!h)
+		return RTC_ERR_INVALID;
+
+	if (!h->glueId)
+		return RTC_ERR_NOT_AVAIL;
+
+	int length = webrtcGetDataChannelLabel(h->glueId, nullptr, 0) + 1;
+	if (!buffer)
+		return length;
+
+	if (size < length)
+		return RTC_ERR_TOO_SMALL;
+
+	webrtcGetDataChannelLabel(h->glueId, buffer, size_t(size));
+	return length;
+}
+
+int rtcGetDataChannelReliability(int dc, rtcReliability *reliability) {
+	Handle *h = GetDataChannel(dc);
+	if (!h || !reliability)
+		return RTC_ERR_INVALID;
+
+	if (!h->glueId)
+		return RTC_ERR_NOT_AVAIL;
+
+	int maxRetransmits = webrtcGetDataChannelMaxRetransmits(h->glueId);
+	int maxPacketLifeTime = webrtcGetDataChannelMaxPacketLifeTime(h->glueId);
+	reliability->unordered = webrtcGetDataChannelUnordered(h->glueId) != 0;
+	reliability->unreliable = maxRetransmits >= 0 || maxPacketLifeTime >= 0;
+	reliability->maxRetransmits = maxRetransmits >= 0 ? unsigned(maxRetransmits) : 0;
+	reliability->maxPacketLifeTime = maxPacketLifeTime >= 0 ? unsigned(maxPacketLifeTime) : 0;
+	return RTC_ERR_SUCCESS;
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "capi.hpp"
+
+extern "C" {
+extern int wsCreateWebSocket(const char *url);
+extern void wsDeleteWebSocket(int ws);
+extern ptrdiff_t wsSendMessage(int ws, const char *buffer, size_t size, int isString);
+extern ptrdiff_t wsGetBufferedAmount(int ws);
+extern void wsSetBufferedAmountLowThreshold(int ws, size_t threshold);
+extern void wsSetUserPointer(int ws, void *ptr);
+}
+
+namespace {
+
+using rtc::capi::Handle;
+
+const rtc::capi::Ops WebSocketOps = {
+    wsDeleteWebSocket,
+    wsSendMessage,
+    wsGetBufferedAmount,
+    wsSetBufferedAmountLowThreshold,
+};
+
+} // namespace
+
+int rtcCreateWebSocket(const char *url) {
+	if (!url)
+		return RTC_ERR_INVALID;
+
+	int glueId = wsCreateWebSocket(url);
+	if (!glueId)
+		return RTC_ERR_FAILURE;
+
+	Handle *h = rtc::capi::CreateHandle(Handle::Kind::WebSocket, glueId, &WebSocketOps);
+	wsSetUserPointer(glueId, rtc::capi::ToUserPointer(h));
+	return h->id;
+}
+
+int rtcDeleteWebSocket(int ws) {
+	Handle *h = rtc::capi::GetHandle(ws);
+	if (!h || h->kind != Handle::Kind::WebSocket)
+		return RTC_ERR_INVALID;
+
+	return rtcDelete(ws);
+}
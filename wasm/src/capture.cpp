@@ -0,0 +1,121 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "capture.hpp"
+
+#include <emscripten/emscripten.h>
+
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+extern int rtcDownloadBuffer(const char *buffer, size_t size, const char *filename);
+}
+
+namespace rtc {
+
+namespace {
+
+const char Magic[6] = {'R', 'T', 'C', 'C', 'A', 'P'};
+const uint8_t Version = 1;
+
+// Record flags
+const uint8_t FlagReceive = 0x01;
+const uint8_t FlagString = 0x02;
+const uint8_t FlagPayload = 0x04;
+const uint8_t FlagStream = 0x08;
+
+} // namespace
+
+Capture::Capture(CaptureInit init) : mInit(std::move(init)) { clear(); }
+
+uint32_t Capture::addStream(const string &label) {
+	// Stream definitions are recorded even when full so that events stay attributable
+	writeStream(label);
+	mStreams.push_back(label);
+	return uint32_t(mStreams.size() - 1);
+}
+
+void Capture::record(uint32_t stream, Direction direction, const byte *data, size_t size,
+                     bool isString) {
+	if (mFull)
+		return;
+
+	bool payload = mInit.payloads && data;
+	if (mData.size() + 1 + 3 * 10 + (payload ? size : 0) > mInit.maxSize) {
+		mFull = true;
+		return;
+	}
+
+	// Timestamps are stored as deltas in microseconds
+	double now = emscripten_get_now();
+	uint64_t delta = uint64_t(std::max(0.0, std::round((now - mLastTime) * 1000.0)));
+	mLastTime += double(delta) / 1000.0;
+
+	uint8_t flags = (direction == Direction::Receive ? FlagReceive : 0) |
+	                (isString ? FlagString : 0) | (payload ? FlagPayload : 0);
+	mData.push_back(byte(flags));
+	writeVarint(delta);
+	writeVarint(stream);
+	writeVarint(size);
+	if (payload)
+		mData.insert(mData.end(), data, data + size);
+}
+
+const binary &Capture::data() const { return mData; }
+
+bool Capture::isFull() const { return mFull; }
+
+void Capture::clear() {
+	mData.clear();
+	for (char c : Magic)
+		mData.push_back(byte(c));
+	mData.push_back(byte(Version));
+	mData.push_back(byte(0));
+	for (const auto &label : mStreams)
+		writeStream(label);
+
+	mLastTime = emscripten_get_now();
+	mFull = false;
+}
+
+bool Capture::download(const string &filename) const {
+	auto buffer = reinterpret_cast<const char *>(mData.data());
+	return rtcDownloadBuffer(buffer, mData.size(), filename.c_str()) != 0;
+}
+
+void Capture::writeStream(const string &label) {
+	mData.push_back(byte(FlagStream));
+	writeVarint(label.size());
+	auto b = reinterpret_cast<const byte *>(label.data());
+	mData.insert(mData.end(), b, b + label.size());
+}
+
+void Capture::writeVarint(uint64_t value) {
+	do {
+		uint8_t b = value & 0x7F;
+		value >>= 7;
+		mData.push_back(byte(value ? b | 0x80 : b));
+	} while (value);
+}
+
+} // namespace rtc
@@ -22,10 +22,43 @@
 
 #include "channel.hpp"
 
+#include <chrono>
+
 namespace rtc {
 
 using std::function;
 
+template <typename F> void Channel::timeDispatch(F &&dispatch) const {
+#if RTC_ENABLE_METRICS
+	using clock = std::chrono::steady_clock;
+	auto start = clock::now();
+	dispatch();
+	double elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	mMetrics.dispatchTime += elapsed;
+	if (elapsed > mMetrics.maxDispatchTime)
+		mMetrics.maxDispatchTime = elapsed;
+#else
+	dispatch();
+#endif
+}
+
+size_t ChannelMetrics::HistogramBucket(size_t size) {
+	size_t bucket = 0;
+	size_t limit = 16;
+	while (size > limit && bucket < HistogramSize - 1) {
+		limit <<= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+bool Channel::send(const MessageBuffer &data) {
+	if (data.isString())
+		return send(data.toVariant());
+
+	return send(data.data(), data.size());
+}
+
 size_t Channel::bufferedAmount() const { return 0; /* Dummy */ }
 
 void Channel::onOpen(std::function<void()> callback) { mOpenCallback = std::move(callback); }
@@ -52,6 +85,10 @@ void Channel::onBufferedAmountLow(std::function<void()> callback) {
 	mBufferedAmountLowCallback = std::move(callback);
 }
 
+void Channel::onMessageBuffer(std::function<void(MessageBuffer data)> callback) {
+	mMessageBufferCallback = std::move(callback);
+}
+
 void Channel::setBufferedAmountLowThreshold(size_t amount) { /* Dummy */
 }
 
@@ -70,9 +107,41 @@ void Channel::triggerError(string error) {
 		mErrorCallback(std::move(error));
 }
 
-void Channel::triggerMessage(const message_variant data) {
+ChannelMetrics Channel::metrics() const {
+#if RTC_ENABLE_METRICS
+	return mMetrics;
+#else
+	return {};
+#endif
+}
+
+void Channel::setCapture(shared_ptr<Capture> capture, const string &label) {
+	mCapture = std::move(capture);
+	mCaptureStream = mCapture ? mCapture->addStream(label) : 0;
+}
+
+void Channel::triggerMessage(message_variant data) {
+	recordReceive(std::visit([](const auto &d) { return d.size(); }, data));
+	if (mCapture)
+		std::visit(overloaded{[this](const binary &b) { captureReceive(b.data(), b.size(), false); },
+		                      [this](const string &s) {
+			                      auto b = reinterpret_cast<const byte *>(s.data());
+			                      captureReceive(b, s.size(), true);
+		                      }},
+		           data);
 	if (mMessageCallback)
-		mMessageCallback(data);
+		timeDispatch([&]() { mMessageCallback(std::move(data)); });
+}
+
+void Channel::triggerMessageBuffer(MessageBuffer data) {
+	if (!mMessageBufferCallback) {
+		triggerMessage(data.toVariant());
+		return;
+	}
+
+	recordReceive(data.size());
+	captureReceive(data.data(), data.size(), data.isString());
+	timeDispatch([&]() { mMessageBufferCallback(std::move(data)); });
 }
 
 void Channel::triggerBufferedAmountLow() {
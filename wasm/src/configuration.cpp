@@ -21,9 +21,25 @@
  */
 
 #include "configuration.hpp"
+#include "log.hpp"
+
+#include <cstdlib>
 
 namespace rtc {
 
+namespace {
+
+uint16_t ParsePort(const string &service) {
+	char *end = nullptr;
+	unsigned long port = std::strtoul(service.c_str(), &end, 10);
+	if (end == service.c_str())
+		RTC_THROW(std::invalid_argument, "Invalid ICE server port: " + service);
+
+	return uint16_t(port);
+}
+
+} // namespace
+
 IceServer::IceServer(const string &url) : hostname(url), port(0), type(Type::Dummy) {}
 
 IceServer::IceServer(string hostname_, uint16_t port_)
@@ -31,11 +47,7 @@ IceServer::IceServer(string hostname_, uint16_t port_)
 
 IceServer::IceServer(string hostname_, string service_)
     : hostname(std::move(hostname_)), type(Type::Stun) {
-	try {
-		port = uint16_t(std::stoul(service_));
-	} catch (...) {
-		throw std::invalid_argument("Invalid ICE server port: " + service_);
-	}
+	port = ParsePort(service_);
 }
 
 IceServer::IceServer(string hostname_, uint16_t port_, string username_, string password_,
@@ -47,11 +59,7 @@ IceServer::IceServer(string hostname_, string service_, string username_, string
                      RelayType relayType_)
     : hostname(std::move(hostname_)), type(Type::Turn), username(std::move(username_)),
       password(std::move(password_)), relayType(relayType_) {
-	try {
-		port = uint16_t(std::stoul(service_));
-	} catch (...) {
-		throw std::invalid_argument("Invalid ICE server port: " + service_);
-	}
+	port = ParsePort(service_);
 }
 
 } // namespace rtc
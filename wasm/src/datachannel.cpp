@@ -21,109 +21,265 @@
  */
 
 #include "datachannel.hpp"
+#include "capi.hpp"
+#include "dispatch.hpp"
+#include "log.hpp"
+#include "scheduler.hpp"
 
 #include <emscripten/emscripten.h>
 
+#include <algorithm>
 #include <chrono>
 #include <exception>
 #include <stdexcept>
 
 extern "C" {
-extern void rtcDeleteDataChannel(int dc);
-extern int rtcGetDataChannelLabel(int dc, char *buffer, int size);
-extern int rtcGetDataChannelUnordered(int dc);
-extern int rtcGetDataChannelMaxPacketLifeTime(int dc);
-extern int rtcGetDataChannelMaxRetransmits(int dc);
-extern void rtcSetOpenCallback(int dc, void (*openCallback)(void *));
-extern void rtcSetErrorCallback(int dc, void (*errorCallback)(const char *, void *));
-extern void rtcSetMessageCallback(int dc, void (*messageCallback)(const char *, int, void *));
-extern void rtcSetBufferedAmountLowCallback(int dc, void (*bufferedAmountLowCallback)(void *));
-extern int rtcGetBufferedAmount(int dc);
-extern void rtcSetBufferedAmountLowThreshold(int dc, int threshold);
-extern int rtcSendMessage(int dc, const char *buffer, int size);
-extern void rtcSetUserPointer(int i, void *ptr);
+extern void webrtcDeleteDataChannel(int dc);
+extern int webrtcGetDataChannelLabel(int dc, char *buffer, size_t size);
+extern int webrtcGetDataChannelUnordered(int dc);
+extern int webrtcGetDataChannelMaxPacketLifeTime(int dc);
+extern int webrtcGetDataChannelMaxRetransmits(int dc);
+extern int webrtcGetDataChannelPriority(int dc);
+extern int webrtcAddForwardingRule(int dc, const int *targets, int count, int type, int deliver);
+extern void webrtcRemoveForwardingRule(int dc, int rule);
+extern void webrtcSetSendAccounting(int dc, int mode);
+extern double webrtcGetForwardedMetric(int dc, int index);
+extern ptrdiff_t webrtcGetBufferedAmount(int dc);
+extern void webrtcSetBufferedAmountLowThreshold(int dc, size_t threshold);
+extern ptrdiff_t webrtcSendMessage(int dc, const char *buffer, size_t size, int isString);
+extern void webrtcBroadcastMessage(const int *dcs, int count, const char *buffer, size_t size,
+                                   int isString, ptrdiff_t *results);
+extern int webrtcSendObject(int dc, int object, size_t chunkSize, void *transfer);
+extern void webrtcSetUserPointer(int i, void *ptr);
+
+EMSCRIPTEN_KEEPALIVE void rtcDispatchOpen(int dc, void *ptr) {
+	rtc::impl::Dispatch::DataChannelOpen(dc, ptr);
 }
 
-namespace rtc {
+EMSCRIPTEN_KEEPALIVE void rtcDispatchError(int dc, const char *error, void *ptr) {
+	rtc::impl::Dispatch::DataChannelError(dc, error, ptr);
+}
 
-using std::function;
+EMSCRIPTEN_KEEPALIVE void rtcDispatchMessage(int dc, char *data, ptrdiff_t size, void *ptr) {
+	rtc::impl::Dispatch::DataChannelMessage(dc, data, size, ptr);
+}
+
+EMSCRIPTEN_KEEPALIVE void rtcDispatchBufferedAmountLow(int dc, void *ptr) {
+	rtc::impl::Dispatch::DataChannelBufferedAmountLow(dc, ptr);
+}
+
+EMSCRIPTEN_KEEPALIVE void rtcDispatchForwardedSend(int dc, size_t size, ptrdiff_t bufferedAmount,
+                                                   void *ptr) {
+	rtc::impl::Dispatch::DataChannelForwardedSend(dc, size, bufferedAmount, ptr);
+}
+}
 
-void DataChannel::OpenCallback(void *ptr) {
-	DataChannel *d = static_cast<DataChannel *>(ptr);
-	if (d)
+namespace rtc::impl {
+
+void Dispatch::DataChannelOpen(int dc, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == dc)
+			rtc::capi::DispatchOpen(h);
+		return;
+	}
+
+	auto *d = static_cast<rtc::DataChannel *>(ptr);
+	if (d && d->mId == dc) {
+		d->recordCrossing();
 		d->triggerOpen();
+	}
 }
 
-void DataChannel::ErrorCallback(const char *error, void *ptr) {
-	DataChannel *d = static_cast<DataChannel *>(ptr);
-	if (d)
-		d->triggerError(string(error ? error : "unknown"));
+void Dispatch::DataChannelError(int dc, const char *error, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == dc)
+			rtc::capi::DispatchError(h, error);
+		return;
+	}
+
+	auto *d = static_cast<rtc::DataChannel *>(ptr);
+	if (d && d->mId == dc) {
+		d->recordCrossing();
+		rtc::string message(error ? error : "unknown");
+		RTC_LOG_WARNING("DataChannel error: ", message);
+		d->triggerError(std::move(message));
+	}
 }
 
-void DataChannel::MessageCallback(const char *data, int size, void *ptr) {
-	DataChannel *d = static_cast<DataChannel *>(ptr);
-	if (d) {
-		if (data) {
-			if (size >= 0) {
-				auto *b = reinterpret_cast<const byte *>(data);
-				d->triggerMessage(binary(b, b + size));
-			} else {
-				d->triggerMessage(string(data));
-			}
-		} else {
+void Dispatch::DataChannelMessage(int dc, char *data, ptrdiff_t size, void *ptr) {
+	auto *h = rtc::capi::FromUserPointer(ptr);
+	auto *d = h ? nullptr : static_cast<rtc::DataChannel *>(ptr);
+	if (!data) {
+		if (h && h->glueId == dc)
+			rtc::capi::DispatchClosed(h);
+		if (d && d->mId == dc) {
+			d->recordCrossing();
 			d->close();
 			d->triggerClosed();
 		}
+		return;
+	}
+
+	// The glue allocated data with rtcAllocMessageBuffer, ownership is taken in any case. Strings
+	// are passed as -(length + 1) so that the exact allocation size is known even if they
+	// contain null characters.
+	using Type = rtc::MessageBuffer::Type;
+	auto *b = reinterpret_cast<rtc::byte *>(data);
+	bool isString = size < 0;
+	size_t capacity = isString ? size_t(-size) : size_t(size);
+	size_t length = isString ? capacity - 1 : capacity;
+	auto buffer = rtc::MessageBuffer::Adopt(b, length, capacity,
+	                                        isString ? Type::String : Type::Binary);
+	if (h && h->glueId == dc) {
+		rtc::capi::DispatchMessage(h, buffer);
+	} else if (d && d->mId == dc) {
+		d->recordCrossing();
+		d->triggerMessageBuffer(std::move(buffer));
 	}
 }
 
-void DataChannel::BufferedAmountLowCallback(void *ptr) {
-	DataChannel *d = static_cast<DataChannel *>(ptr);
-	if (d) {
+void Dispatch::DataChannelBufferedAmountLow(int dc, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == dc)
+			rtc::capi::DispatchBufferedAmountLow(h);
+		return;
+	}
+
+	auto *d = static_cast<rtc::DataChannel *>(ptr);
+	if (d && d->mId == dc) {
+		d->recordCrossing();
 		d->triggerBufferedAmountLow();
 	}
 }
 
+void Dispatch::DataChannelForwardedSend(int dc, size_t size, ptrdiff_t bufferedAmount, void *ptr) {
+	// The C API has nothing to account forwarded sends to
+	if (rtc::capi::FromUserPointer(ptr))
+		return;
+
+	auto *d = static_cast<rtc::DataChannel *>(ptr);
+	if (d && d->mId == dc)
+		d->completeSend(size, bufferedAmount);
+}
+
+} // namespace rtc::impl
+
+namespace rtc {
+
+namespace {
+
+// Accounting of messages forwarded to a channel in JS, see webrtcSetSendAccounting
+enum class SendAccounting : int { None = 0, Count = 1, Report = 2 };
+
+// Layout of the metrics of forwarded messages summed in JS, sizes are counted per histogram bucket
+enum ForwardedMetric : int {
+	ForwardedMessages = 0,
+	ForwardedBytes = 1,
+	ForwardedPeakBufferedAmount = 2,
+	ForwardedSizes = 3
+};
+
+} // namespace
+
+using std::function;
+
 DataChannel::DataChannel(int id) : mId(id), mConnected(false) {
-	rtcSetUserPointer(mId, this);
-	rtcSetOpenCallback(mId, OpenCallback);
-	rtcSetErrorCallback(mId, ErrorCallback);
-	rtcSetMessageCallback(mId, MessageCallback);
-	rtcSetBufferedAmountLowCallback(mId, BufferedAmountLowCallback);
+	webrtcSetUserPointer(mId, this);
 
 	char str[256];
-	rtcGetDataChannelLabel(mId, str, 256);
+	webrtcGetDataChannelLabel(mId, str, 256);
 	mLabel = str;
+	RTC_LOG_VERBOSE("Created DataChannel ", mId, " \"", mLabel, "\"");
+
+#if RTC_ENABLE_METRICS
+	updateSendAccounting();
+#endif
 }
 
 DataChannel::~DataChannel() { close(); }
 
 void DataChannel::close() {
 	mConnected = false;
+	mLatest.clear();
+	mLatestAmount = 0;
+	if (mScheduler) {
+		mScheduler->detach(this);
+		mScheduler.reset();
+	}
 	if (mId) {
-		rtcDeleteDataChannel(mId);
+#if RTC_ENABLE_METRICS
+		mForwardedMetrics = forwardedMetrics();
+#endif
+		webrtcDeleteDataChannel(mId);
 		mId = 0;
 	}
 }
 
 bool DataChannel::send(message_variant message) {
-	if (!mId)
-		return false;
-
 	return std::visit(
 	    overloaded{[this](const binary &b) {
-		               auto data = reinterpret_cast<const char *>(b.data());
-		               return rtcSendMessage(mId, data, int(b.size())) >= 0;
+		               return transmit(reinterpret_cast<const char *>(b.data()), b.size(), false);
 	               },
-	               [this](const string &s) { return rtcSendMessage(mId, s.c_str(), -1) >= 0; }},
+	               [this](const string &s) { return transmit(s.c_str(), s.size(), true); }},
 	    std::move(message));
 }
 
 bool DataChannel::send(const byte *data, size_t size) {
-	if (!mId)
+	return transmit(reinterpret_cast<const char *>(data), size, false);
+}
+
+bool DataChannel::send(const MessageBuffer &data) {
+	// String buffers are null-terminated, so they can be passed to the glue as is
+	return transmit(reinterpret_cast<const char *>(data.data()), data.size(), data.isString());
+}
+
+bool DataChannel::sendObject(ObjectHandle object, TransferInit init) {
+	if (!mId || init.chunkSize == 0)
+		return false;
+
+	// Released by the glue on completion
+	auto transfer = new TransferInit(std::move(init));
+	if (!webrtcSendObject(mId, object, transfer->chunkSize, transfer)) {
+		delete transfer;
 		return false;
+	}
+	return true;
+}
+
+bool DataChannel::sendLatest(uint32_t key, message_variant data) {
+	return std::visit(overloaded{[this, key](const binary &b) {
+		                             auto data = reinterpret_cast<const char *>(b.data());
+		                             return transmitLatest(key, data, b.size(), false);
+	                             },
+	                             [this, key](const string &s) {
+		                             return transmitLatest(key, s.c_str(), s.size(), true);
+	                             }},
+	                  std::move(data));
+}
+
+bool DataChannel::sendLatest(uint32_t key, const byte *data, size_t size) {
+	return transmitLatest(key, reinterpret_cast<const char *>(data), size, false);
+}
+
+int DataChannel::addForwardingRule(const ForwardingRule &rule) {
+	if (!mId)
+		return 0;
+
+	std::vector<int> targets;
+	targets.reserve(rule.targets.size());
+	for (const auto &target : rule.targets)
+		if (target && target->mId)
+			targets.push_back(target->mId);
 
-	return rtcSendMessage(mId, reinterpret_cast<const char *>(data), int(size)) >= 0;
+	int type = rule.type ? int(*rule.type) : -1;
+	return webrtcAddForwardingRule(mId, targets.data(), int(targets.size()), type, rule.deliver);
+}
+
+void DataChannel::removeForwardingRule(int rule) {
+	if (!mId)
+		return;
+
+	webrtcRemoveForwardingRule(mId, rule);
 }
 
 bool DataChannel::isOpen() const { return mConnected; }
@@ -134,11 +290,13 @@ size_t DataChannel::bufferedAmount() const {
 	if (!mId)
 		return 0;
 
-	int ret = rtcGetBufferedAmount(mId);
+	ptrdiff_t ret = webrtcGetBufferedAmount(mId);
+	recordCrossing();
 	if (ret < 0)
 		return 0;
 
-	return size_t(ret);
+	recordBufferedAmount(size_t(ret));
+	return size_t(ret) + mLatestAmount + (mScheduler ? mScheduler->queuedAmount(this) : 0);
 }
 
 std::string DataChannel::label() const { return mLabel; }
@@ -149,10 +307,10 @@ Reliability DataChannel::reliability() const {
 	if (!mId)
 		return reliability;
 
-	reliability.unordered = rtcGetDataChannelUnordered(mId) ? true : false;
+	reliability.unordered = webrtcGetDataChannelUnordered(mId) ? true : false;
 
-	int maxRetransmits = rtcGetDataChannelMaxRetransmits(mId);
-	int maxPacketLifeTime = rtcGetDataChannelMaxPacketLifeTime(mId);
+	int maxRetransmits = webrtcGetDataChannelMaxRetransmits(mId);
+	int maxPacketLifeTime = webrtcGetDataChannelMaxPacketLifeTime(mId);
 
 	if (maxRetransmits >= 0)
 		reliability.maxRetransmits = unsigned(maxRetransmits);
@@ -163,16 +321,238 @@ Reliability DataChannel::reliability() const {
 	return reliability;
 }
 
-void DataChannel::setBufferedAmountLowThreshold(size_t amount) {
+Priority DataChannel::priority() const {
 	if (!mId)
-		return;
+		return Priority::Low;
 
-	rtcSetBufferedAmountLowThreshold(mId, int(amount));
+	return static_cast<Priority>(webrtcGetDataChannelPriority(mId));
+}
+
+void DataChannel::setBufferedAmountLowThreshold(size_t amount) {
+	// The scheduler owns the browser threshold and applies this one to its queue
+	mBufferedAmountLowThreshold = amount;
+	if (!mScheduler)
+		setLowThreshold(amount);
 }
 
 void DataChannel::triggerOpen() {
+	RTC_LOG_DEBUG("DataChannel ", mId, " open");
 	mConnected = true;
 	Channel::triggerOpen();
 }
 
+void DataChannel::triggerBufferedAmountLow() {
+	if (!mScheduler) {
+		mLastBufferedAmount = 0;
+		flushLatest();
+		Channel::triggerBufferedAmountLow();
+		return;
+	}
+
+	auto scheduler = mScheduler;
+	scheduler->update(this, size_t(std::max(webrtcGetBufferedAmount(mId), ptrdiff_t(0))));
+	scheduler->flush();
+	if (scheduler->queuedAmount(this) <= mBufferedAmountLowThreshold)
+		Channel::triggerBufferedAmountLow();
+}
+
+std::vector<bool> DataChannel::transmit(const std::vector<shared_ptr<DataChannel>> &channels,
+                                       const char *data, size_t size, bool isString) {
+	std::vector<bool> results(channels.size(), false);
+	std::vector<int> ids;
+	std::vector<size_t> indexes;
+	ids.reserve(channels.size());
+	indexes.reserve(channels.size());
+	for (size_t i = 0; i < channels.size(); ++i) {
+		DataChannel *channel = channels[i].get();
+		if (!channel || !channel->mId)
+			continue;
+
+		// Channels backed up in the scheduler get their own copy in its queue
+		if (auto scheduler = channel->mScheduler.get()) {
+			if (!scheduler->admit(channel, size)) {
+				results[i] = channel->transmit(data, size, isString);
+				continue;
+			}
+			scheduler->reserve(channel, size);
+		}
+
+		channel->captureSend(reinterpret_cast<const byte *>(data), size, isString);
+		ids.push_back(channel->mId);
+		indexes.push_back(i);
+	}
+
+	if (ids.empty())
+		return results;
+
+	std::vector<ptrdiff_t> rets(ids.size());
+	webrtcBroadcastMessage(ids.data(), int(ids.size()), data, size, isString, rets.data());
+	for (size_t k = 0; k < ids.size(); ++k)
+		results[indexes[k]] = channels[indexes[k]]->completeSend(size, rets[k]);
+
+	return results;
+}
+
+bool DataChannel::transmit(const char *data, size_t size, bool isString) {
+	if (!mId)
+		return false;
+
+	if (mScheduler && !mScheduler->admit(this, size)) {
+		using Type = MessageBuffer::Type;
+		auto b = reinterpret_cast<const byte *>(data);
+		MessageBuffer buffer(b, size, isString ? Type::String : Type::Binary);
+		return mScheduler->enqueue(this, std::move(buffer));
+	}
+
+	return sendNow(data, size, isString);
+}
+
+bool DataChannel::transmitLatest(uint32_t key, const char *data, size_t size, bool isString) {
+	if (!mId)
+		return false;
+
+	using Type = MessageBuffer::Type;
+	auto b = reinterpret_cast<const byte *>(data);
+	if (mScheduler) {
+		if (mScheduler->admit(this, size))
+			return sendNow(data, size, isString);
+
+		MessageBuffer buffer(b, size, isString ? Type::String : Type::Binary);
+		return mScheduler->enqueue(this, std::move(buffer), key);
+	}
+
+	if (mLatest.empty() && mLastBufferedAmount <= mBufferedAmountLowThreshold)
+		return sendNow(data, size, isString);
+
+	// The buffered amount is above the threshold, so a low event is pending to flush the queue
+	MessageBuffer buffer(b, size, isString ? Type::String : Type::Binary);
+	auto it = std::find_if(mLatest.begin(), mLatest.end(),
+	                       [key](const auto &entry) { return entry.first == key; });
+	if (it != mLatest.end()) {
+		mLatestAmount = mLatestAmount - it->second.size() + size;
+		it->second = std::move(buffer);
+	} else {
+		mLatestAmount += size;
+		mLatest.emplace_back(key, std::move(buffer));
+	}
+	return true;
+}
+
+void DataChannel::flushLatest() {
+	// Send until the buffered amount is back above the threshold, the next low event sends the
+	// rest, which keeps coalescing in the meantime
+	while (!mLatest.empty() && mLastBufferedAmount <= mBufferedAmountLowThreshold) {
+		const MessageBuffer &buffer = mLatest.front().second;
+		auto str = reinterpret_cast<const char *>(buffer.data());
+		if (!sendNow(str, buffer.size(), buffer.isString()))
+			return; // Keep the failed message and the following ones queued
+
+		mLatestAmount -= buffer.size();
+		mLatest.pop_front();
+	}
+}
+
+bool DataChannel::sendNow(const char *data, size_t size, bool isString) {
+	if (!mId)
+		return false;
+
+	captureSend(reinterpret_cast<const byte *>(data), size, isString);
+	return completeSend(size, webrtcSendMessage(mId, data, size, isString));
+}
+
+bool DataChannel::completeSend(size_t size, ptrdiff_t result) {
+	recordSend(size, result);
+	if (result >= 0)
+		mLastBufferedAmount = size_t(result);
+	if (mScheduler)
+		mScheduler->update(this, result >= 0 ? size_t(result) : 0);
+
+	return result >= 0;
+}
+
+void DataChannel::attachScheduler(shared_ptr<SendScheduler> scheduler, unsigned int weight) {
+	if (mScheduler)
+		mScheduler->detach(this);
+
+	mScheduler = std::move(scheduler);
+	if (mScheduler)
+		mScheduler->attach(this, weight);
+	else
+		setLowThreshold(mBufferedAmountLowThreshold);
+
+	updateSendAccounting();
+}
+
+ChannelMetrics DataChannel::metrics() const {
+	ChannelMetrics metrics = Channel::metrics();
+#if RTC_ENABLE_METRICS
+	ChannelMetrics forwarded = forwardedMetrics();
+	metrics.messagesSent += forwarded.messagesSent;
+	metrics.bytesSent += forwarded.bytesSent;
+	metrics.peakBufferedAmount = std::max(metrics.peakBufferedAmount, forwarded.peakBufferedAmount);
+	for (size_t i = 0; i < ChannelMetrics::HistogramSize; ++i)
+		metrics.sentSizes[i] += forwarded.sentSizes[i];
+#endif
+	return metrics;
+}
+
+ChannelMetrics DataChannel::forwardedMetrics() const {
+#if RTC_ENABLE_METRICS
+	if (!mId)
+		return mForwardedMetrics;
+
+	// Messages forwarded to this channel in JS are only summed there
+	auto forwarded = [this](int index) { return webrtcGetForwardedMetric(mId, index); };
+	ChannelMetrics metrics;
+	metrics.messagesSent = uint64_t(forwarded(ForwardedMessages));
+	metrics.bytesSent = uint64_t(forwarded(ForwardedBytes));
+	metrics.peakBufferedAmount = size_t(forwarded(ForwardedPeakBufferedAmount));
+	for (size_t i = 0; i < ChannelMetrics::HistogramSize; ++i)
+		metrics.sentSizes[i] = uint64_t(forwarded(ForwardedSizes + int(i)));
+	return metrics;
+#else
+	return {};
+#endif
+}
+
+void DataChannel::updateSendAccounting() {
+	if (!mId)
+		return;
+
+	// Messages forwarded to this channel in JS are only reported back to a scheduler, which must
+	// meter them. Otherwise metrics are summed in JS and read by metrics().
+	SendAccounting mode = SendAccounting::None;
+	if (mScheduler)
+		mode = SendAccounting::Report;
+	else if (RTC_ENABLE_METRICS)
+		mode = SendAccounting::Count;
+
+	webrtcSetSendAccounting(mId, int(mode));
+}
+
+void DataChannel::setLowThreshold(size_t amount) {
+	if (!mId)
+		return;
+
+	webrtcSetBufferedAmountLowThreshold(mId, amount);
+}
+
+std::vector<bool> broadcast(const std::vector<shared_ptr<DataChannel>> &channels,
+                            message_variant data) {
+	return std::visit(overloaded{[&channels](const binary &b) {
+		                             auto data = reinterpret_cast<const char *>(b.data());
+		                             return DataChannel::transmit(channels, data, b.size(), false);
+	                             },
+	                             [&channels](const string &s) {
+		                             return DataChannel::transmit(channels, s.c_str(), s.size(),
+		                                                          true);
+	                             }},
+	                  std::move(data));
+}
+
+std::vector<bool> broadcast(const std::vector<shared_ptr<DataChannel>> &channels,
+                            const byte *data, size_t size) {
+	return DataChannel::transmit(channels, reinterpret_cast<const char *>(data), size, false);
+}
+
 } // namespace rtc
@@ -67,6 +67,7 @@ string Description::typeToString(Type type) {
 
 } // namespace rtc
 
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, const rtc::Description &description) {
 	return out << std::string(description);
 }
@@ -74,3 +75,4 @@ std::ostream &operator<<(std::ostream &out, const rtc::Description &description)
 std::ostream &operator<<(std::ostream &out, rtc::Description::Type type) {
 	return out << rtc::Description::typeToString(type);
 }
+#endif
@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_DISPATCH_H
+#define RTC_DISPATCH_H
+
+#include "common.hpp"
+
+// Entry points called directly by the JS glue, kept out of the public headers
+extern "C" {
+void rtcDispatchLog(int level, const char *message);
+void *rtcAllocMessageBuffer(size_t size);
+
+void rtcDispatchTransferProgress(double sent, double total, void *ptr);
+void rtcDispatchTransferComplete(int success, void *ptr);
+
+void rtcDispatchDataChannel(int pc, int dc, void *ptr);
+void rtcDispatchLocalDescription(int pc, const char *sdp, const char *type, void *ptr);
+void rtcDispatchLocalCandidate(int pc, const char *candidate, const char *mid, void *ptr);
+void rtcDispatchStateChange(int pc, int state, void *ptr);
+void rtcDispatchIceStateChange(int pc, int state, void *ptr);
+void rtcDispatchGatheringStateChange(int pc, int state, void *ptr);
+void rtcDispatchSignalingStateChange(int pc, int state, void *ptr);
+
+void rtcDispatchOpen(int dc, void *ptr);
+void rtcDispatchError(int dc, const char *error, void *ptr);
+void rtcDispatchMessage(int dc, char *data, ptrdiff_t size, void *ptr);
+void rtcDispatchBufferedAmountLow(int dc, void *ptr);
+void rtcDispatchForwardedSend(int dc, size_t size, ptrdiff_t bufferedAmount, void *ptr);
+
+void wsDispatchOpen(int ws, void *ptr);
+void wsDispatchError(int ws, const char *error, void *ptr);
+void wsDispatchMessage(int ws, char *data, ptrdiff_t size, void *ptr);
+void wsDispatchBufferedAmountLow(int ws, void *ptr);
+}
+
+namespace rtc::impl {
+
+// Trampolines from the entry points to the private members of the classes, which befriend it
+struct Dispatch {
+	static void PeerConnectionDataChannel(int pc, int dc, void *ptr);
+	static void PeerConnectionLocalDescription(int pc, const char *sdp, const char *type,
+	                                           void *ptr);
+	static void PeerConnectionLocalCandidate(int pc, const char *candidate, const char *mid,
+	                                         void *ptr);
+	static void PeerConnectionStateChange(int pc, int state, void *ptr);
+	static void PeerConnectionIceStateChange(int pc, int state, void *ptr);
+	static void PeerConnectionGatheringStateChange(int pc, int state, void *ptr);
+	static void PeerConnectionSignalingStateChange(int pc, int state, void *ptr);
+
+	static void DataChannelOpen(int dc, void *ptr);
+	static void DataChannelError(int dc, const char *error, void *ptr);
+	static void DataChannelMessage(int dc, char *data, ptrdiff_t size, void *ptr);
+	static void DataChannelBufferedAmountLow(int dc, void *ptr);
+	static void DataChannelForwardedSend(int dc, size_t size, ptrdiff_t bufferedAmount, void *ptr);
+
+	static void WebSocketOpen(int ws, void *ptr);
+	static void WebSocketError(int ws, const char *error, void *ptr);
+	static void WebSocketMessage(int ws, char *data, ptrdiff_t size, void *ptr);
+	static void WebSocketBufferedAmountLow(int ws, void *ptr);
+};
+
+} // namespace rtc::impl
+
+#endif // RTC_DISPATCH_H
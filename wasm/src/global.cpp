@@ -21,11 +21,75 @@
  */
 
 #include "global.hpp"
+#include "dispatch.hpp"
+#include "log.hpp"
+
+#include <emscripten/emscripten.h>
+
+#include <algorithm>
+#include <cstdio>
+
+extern "C" {
+extern void rtcSetLogLevel(int level);
+
+EMSCRIPTEN_KEEPALIVE void rtcDispatchLog(int level, const char *message) {
+	if (message)
+		rtc::impl::WriteLog(static_cast<rtc::LogLevel>(level), rtc::string(message));
+}
+}
 
 namespace rtc {
 
-void InitLogger([[maybe_unused]] LogLevel level, [[maybe_unused]] LogCallback callback) {
-	// Dummy
+namespace {
+
+LogLevel LoggerLevel = LogLevel::None;
+LogCallback LoggerCallback;
+
+const char *LogLevelName(LogLevel level) {
+	switch (level) {
+	case LogLevel::Fatal:
+		return "fatal";
+	case LogLevel::Error:
+		return "error";
+	case LogLevel::Warning:
+		return "warning";
+	case LogLevel::Info:
+		return "info";
+	case LogLevel::Debug:
+		return "debug";
+	case LogLevel::Verbose:
+		return "verbose";
+	default:
+		return "none";
+	}
+}
+
+} // namespace
+
+namespace impl {
+
+bool IsLogEnabled(LogLevel level) {
+	return level != LogLevel::None && int(level) <= int(LoggerLevel);
+}
+
+void WriteLog(LogLevel level, string message) {
+	if (!IsLogEnabled(level))
+		return;
+
+	if (LoggerCallback)
+		LoggerCallback(level, std::move(message));
+	else
+		std::fprintf(stderr, "rtc %s: %s\n", LogLevelName(level), message.c_str());
+}
+
+} // namespace impl
+
+void InitLogger(LogLevel level, LogCallback callback) {
+	LoggerLevel = level;
+	LoggerCallback = std::move(callback);
+
+	// Messages above the compile-time threshold are not forwarded by the glue either
+	rtcSetLogLevel(std::min(int(level), RTC_LOG_LEVEL));
 }
 
 void Preload() {
@@ -39,31 +103,11 @@ std::shared_future<void> Cleanup() {
 	return p.get_future();
 }
 
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, LogLevel level) {
-	switch (level) {
-	case LogLevel::Fatal:
-		out << "fatal";
-		break;
-	case LogLevel::Error:
-		out << "error";
-		break;
-	case LogLevel::Warning:
-		out << "warning";
-		break;
-	case LogLevel::Info:
-		out << "info";
-		break;
-	case LogLevel::Debug:
-		out << "debug";
-		break;
-	case LogLevel::Verbose:
-		out << "verbose";
-		break;
-	default:
-		out << "none";
-		break;
-	}
+	out << LogLevelName(level);
 	return out;
 }
+#endif
 
 } // namespace rtc
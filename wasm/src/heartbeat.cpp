@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "heartbeat.hpp"
+#include "log.hpp"
+
+#include <emscripten/emscripten.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace rtc {
+
+namespace {
+
+// Messages are a type byte followed by the timestamp of the ping in native byte order, which is
+// only ever read back by the peer that wrote it
+constexpr byte Ping{0};
+constexpr byte Pong{1};
+constexpr size_t MessageSize = 1 + sizeof(double);
+
+} // namespace
+
+Heartbeat::Heartbeat(PeerConnection *peerConnection, HeartbeatInit init,
+                     shared_ptr<DataChannel> channel)
+    : mPeerConnection(peerConnection), mInit(init), mChannel(std::move(channel)) {}
+
+void Heartbeat::start() {
+	// The channel is owned by the heartbeat, so its callbacks must not keep it alive
+	std::weak_ptr<Heartbeat> weak = shared_from_this();
+	mChannel->onOpen([weak]() {
+		if (auto heartbeat = weak.lock())
+			heartbeat->mLastReceived = emscripten_get_now();
+	});
+	mChannel->onMessageBuffer([weak](MessageBuffer message) {
+		if (auto heartbeat = weak.lock())
+			heartbeat->receive(message);
+	});
+	mChannel->onClosed([weak]() {
+		if (auto heartbeat = weak.lock())
+			heartbeat->lost();
+	});
+	schedule();
+}
+
+optional<std::chrono::microseconds> Heartbeat::roundTripTime() const { return mRoundTripTime; }
+
+bool Heartbeat::isResponsive() const { return mResponsive; }
+
+void Heartbeat::Tick(void *arg) {
+	// Timers cannot be cancelled, so they only hold a weak reference
+	std::unique_ptr<std::weak_ptr<Heartbeat>> weak(static_cast<std::weak_ptr<Heartbeat> *>(arg));
+	if (auto heartbeat = weak->lock()) {
+		heartbeat->tick();
+		heartbeat->schedule();
+	}
+}
+
+void Heartbeat::schedule() {
+	emscripten_async_call(Tick, new std::weak_ptr<Heartbeat>(weak_from_this()),
+	                      int(mInit.interval.count()));
+}
+
+void Heartbeat::tick() {
+	if (!mChannel->isOpen())
+		return;
+
+	double now = emscripten_get_now();
+	send(Ping, now);
+
+	double timeout = double(mInit.interval.count()) * mInit.missThreshold;
+	if (mResponsive && now - mLastReceived > timeout) {
+		RTC_LOG_WARNING("Peer unresponsive, no heartbeat for ", now - mLastReceived, " ms");
+		mResponsive = false;
+		mPeerConnection->triggerPeerUnresponsive();
+	}
+}
+
+void Heartbeat::receive(const MessageBuffer &message) {
+	if (message.isString() || message.size() != MessageSize)
+		return;
+
+	double now = emscripten_get_now();
+	double timestamp;
+	std::memcpy(&timestamp, message.data() + 1, sizeof(timestamp));
+	byte type = message.data()[0];
+	if (type == Ping) {
+		send(Pong, timestamp);
+	} else if (type == Pong && timestamp <= now) {
+		auto rtt = std::chrono::microseconds(std::llround((now - timestamp) * 1000.0));
+		mRoundTripTime = rtt;
+		mPeerConnection->triggerRoundTripTime(rtt);
+	}
+
+	mLastReceived = now;
+	if (!mResponsive) {
+		RTC_LOG_INFO("Peer responsive again");
+		mResponsive = true;
+		mPeerConnection->triggerPeerResponsive();
+	}
+}
+
+void Heartbeat::send(byte type, double timestamp) {
+	byte message[MessageSize];
+	message[0] = type;
+	std::memcpy(message + 1, &timestamp, sizeof(timestamp));
+	mChannel->send(message, MessageSize);
+}
+
+void Heartbeat::lost() {
+	if (!mResponsive)
+		return;
+
+	RTC_LOG_WARNING("Peer unresponsive, heartbeat channel closed");
+	mResponsive = false;
+	mPeerConnection->triggerPeerUnresponsive();
+}
+
+} // namespace rtc
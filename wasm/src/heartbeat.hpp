@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_HEARTBEAT_H
+#define RTC_HEARTBEAT_H
+
+#include "datachannel.hpp"
+#include "message.hpp"
+#include "peerconnection.hpp"
+
+#include <chrono>
+#include <memory>
+#include <optional>
+
+namespace rtc {
+
+// Heartbeat exchanged with the remote peer on a negotiated channel. Each side sends a ping every
+// interval, answered by a pong echoing its timestamp, and the peer is deemed unresponsive once
+// nothing at all has been received from it for the configured number of intervals.
+class Heartbeat final : public std::enable_shared_from_this<Heartbeat> {
+public:
+	Heartbeat(PeerConnection *peerConnection, HeartbeatInit init, shared_ptr<DataChannel> channel);
+
+	void start();
+
+	optional<std::chrono::microseconds> roundTripTime() const;
+	bool isResponsive() const;
+
+private:
+	static void Tick(void *arg);
+
+	void schedule();
+	void tick();
+	void receive(const MessageBuffer &message);
+	void send(byte type, double timestamp);
+	void lost();
+
+	PeerConnection *const mPeerConnection;
+	const HeartbeatInit mInit;
+	const shared_ptr<DataChannel> mChannel;
+	double mLastReceived = 0; // on the clock of emscripten_get_now(), in milliseconds
+	bool mResponsive = true;
+	optional<std::chrono::microseconds> mRoundTripTime;
+};
+
+} // namespace rtc
+
+#endif // RTC_HEARTBEAT_H
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_LOG_H
+#define RTC_LOG_H
+
+#include "global.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+
+// Messages above RTC_LOG_LEVEL are compiled out, arguments and formatting included. It defaults
+// to Info in release builds and Verbose otherwise, see DATACHANNEL_WASM_LOG_LEVEL.
+#ifndef RTC_LOG_LEVEL
+#ifdef NDEBUG
+#define RTC_LOG_LEVEL 4
+#else
+#define RTC_LOG_LEVEL 6
+#endif
+#endif
+
+namespace rtc::impl {
+
+bool IsLogEnabled(LogLevel level);
+void WriteLog(LogLevel level, string message);
+
+inline void AppendLog(string &out, const string &str) { out += str; }
+inline void AppendLog(string &out, const char *str) { out += str ? str : "(null)"; }
+inline void AppendLog(string &out, char c) { out += c; }
+inline void AppendLog(string &out, bool b) { out += b ? "true" : "false"; }
+
+template <typename T>
+inline std::enable_if_t<std::is_arithmetic_v<T>> AppendLog(string &out, T value) {
+	out += std::to_string(value);
+}
+
+template <typename... Args> string FormatLog(Args &&...args) {
+	string out;
+	(AppendLog(out, std::forward<Args>(args)), ...);
+	return out;
+}
+
+} // namespace rtc::impl
+
+#define RTC_LOG(level, ...)                                                                        \
+	do {                                                                                           \
+		if (rtc::impl::IsLogEnabled(level))                                                        \
+			rtc::impl::WriteLog(level, rtc::impl::FormatLog(__VA_ARGS__));                         \
+	} while (0)
+
+#define RTC_LOG_DISABLED(...) ((void)0)
+
+#if RTC_LOG_LEVEL >= 1
+#define RTC_LOG_FATAL(...) RTC_LOG(rtc::LogLevel::Fatal, __VA_ARGS__)
+#else
+#define RTC_LOG_FATAL RTC_LOG_DISABLED
+#endif
+
+#if RTC_LOG_LEVEL >= 2
+#define RTC_LOG_ERROR(...) RTC_LOG(rtc::LogLevel::Error, __VA_ARGS__)
+#else
+#define RTC_LOG_ERROR RTC_LOG_DISABLED
+#endif
+
+#if RTC_LOG_LEVEL >= 3
+#define RTC_LOG_WARNING(...) RTC_LOG(rtc::LogLevel::Warning, __VA_ARGS__)
+#else
+#define RTC_LOG_WARNING RTC_LOG_DISABLED
+#endif
+
+#if RTC_LOG_LEVEL >= 4
+#define RTC_LOG_INFO(...) RTC_LOG(rtc::LogLevel::Info, __VA_ARGS__)
+#else
+#define RTC_LOG_INFO RTC_LOG_DISABLED
+#endif
+
+#if RTC_LOG_LEVEL >= 5
+#define RTC_LOG_DEBUG(...) RTC_LOG(rtc::LogLevel::Debug, __VA_ARGS__)
+#else
+#define RTC_LOG_DEBUG RTC_LOG_DISABLED
+#endif
+
+#if RTC_LOG_LEVEL >= 6
+#define RTC_LOG_VERBOSE(...) RTC_LOG(rtc::LogLevel::Verbose, __VA_ARGS__)
+#else
+#define RTC_LOG_VERBOSE RTC_LOG_DISABLED
+#endif
+
+// Without exception support, errors that would throw are logged as fatal and abort instead
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+#define RTC_THROW(exception, message) throw exception(message)
+#else
+#define RTC_THROW(exception, message)                                                              \
+	do {                                                                                           \
+		RTC_LOG_FATAL(message);                                                                    \
+		std::abort();                                                                              \
+	} while (0)
+#endif
+
+#endif // RTC_LOG_H
@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "message.hpp"
+#include "dispatch.hpp"
+#include "log.hpp"
+
+#include <emscripten/emscripten.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace rtc {
+
+namespace {
+
+// Blocks from 64 bytes to 64 KiB are carved out of slabs and recycled through intrusive free
+// lists. Slabs are never returned, so memory usage is bounded by the peak of each size class.
+// Larger payloads are rare enough to go straight to malloc.
+class SlabArena final {
+public:
+	void *allocate(size_t size) {
+		size_t index = sizeClass(size);
+		if (index >= ClassCount)
+			return std::malloc(size);
+
+		if (!mFreeLists[index])
+			refill(index);
+
+		FreeBlock *block = mFreeLists[index];
+		mFreeLists[index] = block->next;
+		return block;
+	}
+
+	void deallocate(void *ptr, size_t size) {
+		size_t index = sizeClass(size);
+		if (index >= ClassCount) {
+			std::free(ptr);
+			return;
+		}
+
+		auto *block = static_cast<FreeBlock *>(ptr);
+		block->next = mFreeLists[index];
+		mFreeLists[index] = block;
+	}
+
+private:
+	struct FreeBlock {
+		FreeBlock *next;
+	};
+
+	static constexpr size_t MinBlockShift = 6;
+	static constexpr size_t ClassCount = 11;
+	static constexpr size_t MinSlabSize = 16 * 1024;
+	static constexpr size_t MinSlabBlocks = 4;
+
+	static size_t sizeClass(size_t size) {
+		size_t index = 0;
+		while ((size_t(1) << (index + MinBlockShift)) < size && index < ClassCount)
+			++index;
+		return index;
+	}
+
+	void refill(size_t index) {
+		size_t blockSize = size_t(1) << (index + MinBlockShift);
+		size_t slabSize = std::max(MinSlabSize, blockSize * MinSlabBlocks);
+		auto *slab = static_cast<byte *>(std::malloc(slabSize));
+		if (!slab)
+			RTC_THROW(std::runtime_error, "Failed to allocate a message slab");
+
+		for (size_t offset = slabSize; offset >= blockSize; offset -= blockSize) {
+			auto *block = reinterpret_cast<FreeBlock *>(slab + offset - blockSize);
+			block->next = mFreeLists[index];
+			mFreeLists[index] = block;
+		}
+	}
+
+	std::array<FreeBlock *, ClassCount> mFreeLists = {};
+};
+
+SlabArena DefaultArena;
+MessageAllocator CurrentAllocator;
+
+// Small payloads from the glue are written here then copied inline on adoption, which happens
+// synchronously within the same dispatch
+alignas(std::max_align_t) byte ScratchArea[MessageBuffer::InlineSize];
+
+void *AllocateMessage(size_t size) {
+	size = std::max(size, size_t(1));
+	if (CurrentAllocator.allocate)
+		return CurrentAllocator.allocate(size);
+
+	return DefaultArena.allocate(size);
+}
+
+void DeallocateMessage(void *ptr, size_t size) {
+	size = std::max(size, size_t(1));
+	if (CurrentAllocator.deallocate)
+		CurrentAllocator.deallocate(ptr, size);
+	else
+		DefaultArena.deallocate(ptr, size);
+}
+
+} // namespace
+
+void SetMessageAllocator(MessageAllocator allocator) { CurrentAllocator = std::move(allocator); }
+
+MessageBuffer::MessageBuffer(size_t size, Type type) { allocate(size, type); }
+
+MessageBuffer::MessageBuffer(const byte *data, size_t size, Type type) {
+	allocate(size, type);
+	if (size > 0)
+		std::memcpy(mData, data, size);
+}
+
+MessageBuffer::MessageBuffer(const string &str)
+    : MessageBuffer(reinterpret_cast<const byte *>(str.data()), str.size(), Type::String) {}
+
+MessageBuffer::MessageBuffer(const message_variant &message) {
+	std::visit(overloaded{[this](const binary &b) {
+		                      allocate(b.size(), Type::Binary);
+		                      if (!b.empty())
+			                      std::memcpy(mData, b.data(), b.size());
+	                      },
+	                      [this](const string &s) {
+		                      allocate(s.size(), Type::String);
+		                      std::memcpy(mData, s.data(), s.size());
+	                      }},
+	           message);
+}
+
+MessageBuffer::MessageBuffer(MessageBuffer &&other) noexcept { *this = std::move(other); }
+
+MessageBuffer::~MessageBuffer() { release(); }
+
+MessageBuffer &MessageBuffer::operator=(MessageBuffer &&other) noexcept {
+	if (this == &other)
+		return *this;
+
+	release();
+	mSize = std::exchange(other.mSize, 0);
+	mCapacity = std::exchange(other.mCapacity, 0);
+	mType = other.mType;
+	if (other.isInline()) {
+		std::memcpy(mInline, other.mInline, InlineSize);
+		mData = mInline;
+		other.mData = nullptr;
+	} else {
+		mData = std::exchange(other.mData, nullptr);
+	}
+	return *this;
+}
+
+MessageBuffer MessageBuffer::Adopt(byte *data, size_t size, size_t capacity, Type type) {
+	MessageBuffer buffer;
+	if (data == ScratchArea) {
+		buffer.allocate(size, type);
+		std::memcpy(buffer.mData, data, size);
+		return buffer;
+	}
+
+	buffer.mData = data;
+	buffer.mSize = size;
+	buffer.mCapacity = capacity;
+	buffer.mType = type;
+	return buffer;
+}
+
+message_variant MessageBuffer::toVariant() const {
+	if (mType == Type::String)
+		return string(reinterpret_cast<const char *>(mData), mSize);
+	else
+		return binary(mData, mData + mSize);
+}
+
+void MessageBuffer::allocate(size_t size, Type type) {
+	size_t capacity = type == Type::String ? size + 1 : size;
+	if (capacity <= InlineSize) {
+		mData = mInline;
+		mCapacity = InlineSize;
+	} else {
+		mData = static_cast<byte *>(AllocateMessage(capacity));
+		mCapacity = capacity;
+	}
+	mSize = size;
+	mType = type;
+	if (type == Type::String)
+		mData[size] = byte(0);
+}
+
+void MessageBuffer::release() {
+	if (mData && !isInline())
+		DeallocateMessage(mData, mCapacity);
+
+	mData = nullptr;
+}
+
+} // namespace rtc
+
+extern "C" {
+
+// Receive buffers are allocated by the glue and adopted by the dispatch entry points
+EMSCRIPTEN_KEEPALIVE void *rtcAllocMessageBuffer(size_t size) {
+	if (size <= rtc::MessageBuffer::InlineSize)
+		return rtc::ScratchArea;
+
+	return rtc::AllocateMessage(size);
+}
+}
@@ -0,0 +1,369 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "mux.hpp"
+#include "log.hpp"
+
+#include <emscripten/emscripten.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rtc {
+
+using std::function;
+
+namespace {
+
+// Frames are prefixed with a LEB128 varint holding (stream id << 1 | is string)
+const size_t MaxHeaderSize = 5;
+
+size_t writeHeader(byte *out, uint32_t id, bool isString) {
+	uint64_t value = (uint64_t(id) << 1) | (isString ? 1 : 0);
+	size_t len = 0;
+	do {
+		uint8_t b = value & 0x7F;
+		value >>= 7;
+		out[len++] = byte(value ? b | 0x80 : b);
+	} while (value);
+	return len;
+}
+
+bool readHeader(const MessageBuffer &frame, uint32_t &id, bool &isString, size_t &len) {
+	uint64_t value = 0;
+	len = 0;
+	while (len < frame.size() && len < MaxHeaderSize) {
+		uint8_t b = std::to_integer<uint8_t>(frame.data()[len]);
+		value |= uint64_t(b & 0x7F) << (7 * len);
+		++len;
+		if (!(b & 0x80)) {
+			id = uint32_t(value >> 1);
+			isString = (value & 1) != 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Small frames fit in the inline storage of the buffer and do not allocate
+MessageBuffer makeFrame(uint32_t id, bool isString, const byte *data, size_t size) {
+	byte header[MaxHeaderSize];
+	size_t len = writeHeader(header, id, isString);
+	MessageBuffer frame(len + size);
+	std::copy(header, header + len, frame.data());
+	std::copy(data, data + size, frame.data() + len);
+	return frame;
+}
+
+} // namespace
+
+MuxStream::MuxStream(Mux *mux, uint32_t id, unsigned int weight)
+    : mMux(mux), mId(id), mWeight(std::max(weight, 1u)) {}
+
+MuxStream::~MuxStream() { close(); }
+
+void MuxStream::close() {
+	if (mMux) {
+		mMux->detach(this);
+		mMux = nullptr;
+		mQueue.clear();
+		mQueuedAmount = 0;
+		triggerClosed();
+	}
+}
+
+bool MuxStream::send(message_variant data) {
+	return std::visit(overloaded{[this](const binary &b) {
+		                             captureSend(b.data(), b.size(), false);
+		                             return enqueue(makeFrame(mId, false, b.data(), b.size()));
+	                             },
+	                             [this](const string &s) {
+		                             auto b = reinterpret_cast<const byte *>(s.data());
+		                             captureSend(b, s.size(), true);
+		                             return enqueue(makeFrame(mId, true, b, s.size()));
+	                             }},
+	                  std::move(data));
+}
+
+bool MuxStream::send(const byte *data, size_t size) {
+	captureSend(data, size, false);
+	return enqueue(makeFrame(mId, false, data, size));
+}
+
+bool MuxStream::send(const MessageBuffer &data) {
+	captureSend(data.data(), data.size(), data.isString());
+	return enqueue(makeFrame(mId, data.isString(), data.data(), data.size()));
+}
+
+bool MuxStream::isOpen() const { return mMux && mMux->isOpen(); }
+
+bool MuxStream::isClosed() const { return !mMux || mMux->isClosed(); }
+
+size_t MuxStream::bufferedAmount() const { return mQueuedAmount; }
+
+uint32_t MuxStream::id() const { return mId; }
+
+unsigned int MuxStream::weight() const { return mWeight; }
+
+void MuxStream::setWeight(unsigned int weight) { mWeight = std::max(weight, 1u); }
+
+void MuxStream::setBufferedAmountLowThreshold(size_t amount) {
+	mBufferedAmountLowThreshold = amount;
+}
+
+bool MuxStream::enqueue(MessageBuffer frame) {
+	if (!mMux)
+		return false;
+
+	return mMux->schedule(shared_from_this(), std::move(frame));
+}
+
+Mux::Mux(shared_ptr<Channel> channel, MuxInit init)
+    : mChannel(std::move(channel)), mInit(std::move(init)) {
+	if (!mChannel)
+		RTC_THROW(std::invalid_argument, "Mux requires a channel");
+
+	if (mInit.quantum == 0)
+		RTC_THROW(std::invalid_argument, "Mux quantum must be positive");
+
+	// The mux takes over the channel callbacks, it is single-threaded like the rest of the
+	// library so capturing this is safe as callbacks are reset on destruction.
+	mChannel->onOpen([this]() { triggerOpen(); });
+	mChannel->onClosed([this]() { triggerClosed(); });
+	mChannel->onError([this](string error) { triggerError(std::move(error)); });
+	mChannel->onMessageBuffer([this](MessageBuffer frame) { triggerMessage(std::move(frame)); });
+	mChannel->onBufferedAmountLow([this]() {
+		// The channel is now at most at the threshold, without asking it
+		mBufferedAmount = std::min(mBufferedAmount, mInit.maxBufferedAmount / 2);
+		flush();
+	});
+	mChannel->setBufferedAmountLowThreshold(mInit.maxBufferedAmount / 2);
+	mBufferedAmount = mChannel->bufferedAmount();
+}
+
+Mux::~Mux() {
+	mChannel->onOpen(nullptr);
+	mChannel->onClosed(nullptr);
+	mChannel->onError(nullptr);
+	mChannel->onMessageBuffer(nullptr);
+	mChannel->onBufferedAmountLow(nullptr);
+
+	mActive.clear();
+	auto streams = std::move(mStreams);
+	for (auto &[id, weakStream] : streams)
+		if (auto stream = weakStream.lock())
+			stream->close();
+}
+
+void Mux::close() { mChannel->close(); }
+
+bool Mux::isOpen() const { return mChannel->isOpen(); }
+
+bool Mux::isClosed() const { return mChannel->isClosed(); }
+
+shared_ptr<MuxStream> Mux::openStream(uint32_t id, unsigned int weight) {
+	if (auto it = mStreams.find(id); it != mStreams.end())
+		if (auto stream = it->second.lock())
+			return stream;
+
+	auto stream = createStream(id, weight);
+
+	// On an open channel, the stream opens once the caller had a chance to set its callbacks
+	if (mChannel->isOpen())
+		emscripten_async_call(TriggerStreamOpen, new std::weak_ptr<MuxStream>(stream), 0);
+
+	return stream;
+}
+
+shared_ptr<Channel> Mux::channel() const { return mChannel; }
+
+void Mux::onStream(function<void(shared_ptr<MuxStream> stream)> callback) {
+	mStreamCallback = std::move(callback);
+}
+
+void Mux::TriggerStreamOpen(void *arg) {
+	std::unique_ptr<std::weak_ptr<MuxStream>> weak(static_cast<std::weak_ptr<MuxStream> *>(arg));
+	if (auto stream = weak->lock(); stream && stream->isOpen())
+		stream->triggerOpen();
+}
+
+shared_ptr<MuxStream> Mux::createStream(uint32_t id, unsigned int weight) {
+	auto stream = shared_ptr<MuxStream>(new MuxStream(this, id, weight));
+	mStreams[id] = stream;
+	return stream;
+}
+
+bool Mux::schedule(shared_ptr<MuxStream> stream, MessageBuffer frame) {
+	if (!mChannel->isOpen())
+		return false;
+
+	// Fast path: nothing is queued and the channel has room
+	if (mActive.empty() && hasRoom(frame.size()))
+		return sendFrame(frame);
+
+	bool wasQueued = !stream->mQueue.empty();
+	stream->mQueuedAmount += frame.size();
+	stream->mQueue.push_back(std::move(frame));
+	if (!wasQueued)
+		mActive.push_back(std::move(stream));
+
+	flush();
+	return true;
+}
+
+bool Mux::hasRoom(size_t size) {
+	// Querying the buffered amount of a data channel calls into JS, so frames sent since it was
+	// last read are added to it instead. This overestimates it as the channel drains, and it is
+	// only read again once the estimate leaves no room.
+	if (mBufferedAmount + size <= mInit.maxBufferedAmount)
+		return true;
+
+	mBufferedAmount = mChannel->bufferedAmount();
+	return mBufferedAmount + size <= mInit.maxBufferedAmount;
+}
+
+bool Mux::sendFrame(const MessageBuffer &frame) {
+	if (!mChannel->send(frame))
+		return false;
+
+	mBufferedAmount += frame.size();
+	return true;
+}
+
+void Mux::flush() {
+	// Deficit round robin over queued streams, weighted by stream weight
+	while (!mActive.empty()) {
+		if (!hasRoom(1))
+			return;
+
+		auto stream = mActive.front();
+		mActive.pop_front();
+		size_t quantum = mInit.quantum * stream->mWeight;
+		if (!stream->mResuming)
+			stream->mDeficit += quantum;
+
+		stream->mResuming = false;
+
+		bool full = false;
+		auto &queue = stream->mQueue;
+		while (!queue.empty() && queue.front().size() <= stream->mDeficit) {
+			if (!hasRoom(1)) {
+				full = true;
+				break;
+			}
+
+			MessageBuffer frame = std::move(queue.front());
+			queue.pop_front();
+			size_t size = frame.size();
+			stream->mDeficit -= size;
+			bool wasAboveThreshold = stream->mQueuedAmount > stream->mBufferedAmountLowThreshold;
+			stream->mQueuedAmount -= size;
+			if (!sendFrame(frame)) {
+				queue.clear();
+				stream->mQueuedAmount = 0;
+			}
+			if (wasAboveThreshold && stream->mQueuedAmount <= stream->mBufferedAmountLowThreshold)
+				stream->triggerBufferedAmountLow();
+		}
+
+		if (queue.empty()) {
+			stream->mDeficit = 0;
+			continue;
+		}
+
+		// A stream never carries more than a round's worth of credit, or what its next message
+		// needs, so that it cannot burst past its share after being held back
+		stream->mDeficit = std::min(stream->mDeficit, std::max(quantum, queue.front().size()));
+		if (full) {
+			// Keep its turn so the stream resumes first on the next flush
+			stream->mResuming = true;
+			mActive.push_front(std::move(stream));
+			return;
+		}
+
+		mActive.push_back(std::move(stream));
+	}
+}
+
+void Mux::detach(MuxStream *stream) {
+	mActive.erase(std::remove_if(mActive.begin(), mActive.end(),
+	                             [stream](const auto &s) { return s.get() == stream; }),
+	              mActive.end());
+
+	if (auto it = mStreams.find(stream->mId); it != mStreams.end()) {
+		auto current = it->second.lock();
+		if (!current || current.get() == stream)
+			mStreams.erase(it);
+	}
+}
+
+void Mux::triggerOpen() {
+	for (auto &[id, weakStream] : mStreams)
+		if (auto stream = weakStream.lock())
+			stream->triggerOpen();
+}
+
+void Mux::triggerClosed() {
+	auto streams = std::move(mStreams);
+	mActive.clear();
+	for (auto &[id, weakStream] : streams)
+		if (auto stream = weakStream.lock())
+			stream->close();
+}
+
+void Mux::triggerError(string error) {
+	for (auto &[id, weakStream] : mStreams)
+		if (auto stream = weakStream.lock())
+			stream->triggerError(error);
+}
+
+void Mux::triggerMessage(MessageBuffer frame) {
+	if (frame.isString())
+		return;
+
+	uint32_t id;
+	bool isString;
+	size_t len;
+	if (!readHeader(frame, id, isString, len))
+		return;
+
+	shared_ptr<MuxStream> stream;
+	if (auto it = mStreams.find(id); it != mStreams.end())
+		stream = it->second.lock();
+
+	if (!stream) {
+		// Remotely opened stream
+		if (!mStreamCallback)
+			return;
+
+		stream = createStream(id, 1);
+		mStreamCallback(stream);
+		if (stream->isOpen())
+			stream->triggerOpen();
+	}
+
+	using Type = MessageBuffer::Type;
+	stream->triggerMessageBuffer(MessageBuffer(frame.data() + len, frame.size() - len,
+	                                           isString ? Type::String : Type::Binary));
+}
+
+} // namespace rtc
@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "object.hpp"
+#include "dispatch.hpp"
+
+#include <emscripten/emscripten.h>
+
+#include <memory>
+
+extern "C" {
+extern void rtcReleaseObject(int object);
+
+EMSCRIPTEN_KEEPALIVE void rtcDispatchTransferProgress(double sent, double total, void *ptr) {
+	auto init = static_cast<rtc::TransferInit *>(ptr);
+	if (init && init->onProgress)
+		init->onProgress(size_t(sent), size_t(total));
+}
+
+EMSCRIPTEN_KEEPALIVE void rtcDispatchTransferComplete(int success, void *ptr) {
+	// The transfer owns its init, which is released once complete
+	std::unique_ptr<rtc::TransferInit> init(static_cast<rtc::TransferInit *>(ptr));
+	if (init && init->onComplete)
+		init->onComplete(success != 0);
+}
+}
+
+namespace rtc {
+
+void ReleaseObject(ObjectHandle object) { rtcReleaseObject(object); }
+
+} // namespace rtc
@@ -21,87 +21,170 @@
  */
 
 #include "peerconnection.hpp"
+#include "capi.hpp"
+#include "dispatch.hpp"
+#include "heartbeat.hpp"
+#include "log.hpp"
+#include "scheduler.hpp"
 
 #include <emscripten/emscripten.h>
 
+#include <algorithm>
 #include <exception>
-#include <iostream>
 #include <stdexcept>
 
 extern "C" {
-extern int rtcCreatePeerConnection(const char **pUrls, const char **pUsernames,
-                                   const char **pPasswords, int nIceServers);
-extern void rtcDeletePeerConnection(int pc);
-extern char *rtcGetLocalDescription(int pc);
-extern char *rtcGetLocalDescriptionType(int pc);
-extern char *rtcGetRemoteDescription(int pc);
-extern char *rtcGetRemoteDescriptionType(int pc);
-extern int rtcCreateDataChannel(int pc, const char *label, bool unordered, int maxRetransmits,
-                                int maxPacketLifeTime);
-extern void rtcSetDataChannelCallback(int pc, void (*dataChannelCallback)(int, void *));
-extern void rtcSetLocalDescriptionCallback(int pc,
-                                           void (*descriptionCallback)(const char *, const char *,
-                                                                       void *));
-extern void rtcSetLocalCandidateCallback(int pc, void (*candidateCallback)(const char *,
-                                                                           const char *, void *));
-extern void rtcSetStateChangeCallback(int pc, void (*stateChangeCallback)(int, void *));
-extern void rtcSetIceStateChangeCallback(int pc, void (*iceStateChangeCallback)(int, void *));
-extern void rtcSetGatheringStateChangeCallback(int pc,
-                                               void (*gatheringStateChangeCallback)(int, void *));
-extern void rtcSetSignalingStateChangeCallback(int pc,
-                                               void (*signalingStateChangeCallback)(int, void *));
-extern void rtcSetRemoteDescription(int pc, const char *sdp, const char *type);
-extern void rtcAddRemoteCandidate(int pc, const char *candidate, const char *mid);
-extern void rtcSetUserPointer(int i, void *ptr);
+extern int webrtcCreatePeerConnection(const char **pUrls, const char **pUsernames,
+                                      const char **pPasswords, int nIceServers,
+                                      bool timelineMarks);
+extern int webrtcGetTimeline(int pc, double *buffer, int count);
+extern int webrtcGetTimelineLabel(int pc, int index, char *buffer, size_t size);
+extern void webrtcDeletePeerConnection(int pc);
+extern char *webrtcGetLocalDescription(int pc);
+extern char *webrtcGetLocalDescriptionType(int pc);
+extern char *webrtcGetRemoteDescription(int pc);
+extern char *webrtcGetRemoteDescriptionType(int pc);
+extern int webrtcCreateDataChannel(int pc, const char *label, bool unordered,
+                                   int maxRetransmits, int maxPacketLifeTime, int priority,
+                                   int id);
+extern void webrtcSetRemoteDescription(int pc, const char *sdp, const char *type);
+extern void webrtcAddRemoteCandidate(int pc, const char *candidate, const char *mid);
+extern void webrtcSetUserPointer(int i, void *ptr);
+
+EMSCRIPTEN_KEEPALIVE void rtcDispatchDataChannel(int pc, int dc, void *ptr) {
+	rtc::impl::Dispatch::PeerConnectionDataChannel(pc, dc, ptr);
 }
 
-namespace rtc {
+EMSCRIPTEN_KEEPALIVE void rtcDispatchLocalDescription(int pc, const char *sdp, const char *type,
+                                                      void *ptr) {
+	rtc::impl::Dispatch::PeerConnectionLocalDescription(pc, sdp, type, ptr);
+}
 
-using std::function;
-using std::vector;
+EMSCRIPTEN_KEEPALIVE void rtcDispatchLocalCandidate(int pc, const char *candidate, const char *mid,
+                                                    void *ptr) {
+	rtc::impl::Dispatch::PeerConnectionLocalCandidate(pc, candidate, mid, ptr);
+}
 
-void PeerConnection::DataChannelCallback(int dc, void *ptr) {
-	PeerConnection *p = static_cast<PeerConnection *>(ptr);
-	if (p)
-		p->triggerDataChannel(std::make_shared<DataChannel>(dc));
+EMSCRIPTEN_KEEPALIVE void rtcDispatchStateChange(int pc, int state, void *ptr) {
+	rtc::impl::Dispatch::PeerConnectionStateChange(pc, state, ptr);
 }
 
-void PeerConnection::DescriptionCallback(const char *sdp, const char *type, void *ptr) {
-	PeerConnection *p = static_cast<PeerConnection *>(ptr);
-	if (p)
-		p->triggerLocalDescription(Description(sdp, type));
+EMSCRIPTEN_KEEPALIVE void rtcDispatchIceStateChange(int pc, int state, void *ptr) {
+	rtc::impl::Dispatch::PeerConnectionIceStateChange(pc, state, ptr);
 }
 
-void PeerConnection::CandidateCallback(const char *candidate, const char *mid, void *ptr) {
-	PeerConnection *p = static_cast<PeerConnection *>(ptr);
-	if (p)
-		p->triggerLocalCandidate(Candidate(candidate, mid));
+EMSCRIPTEN_KEEPALIVE void rtcDispatchGatheringStateChange(int pc, int state, void *ptr) {
+	rtc::impl::Dispatch::PeerConnectionGatheringStateChange(pc, state, ptr);
 }
 
-void PeerConnection::StateChangeCallback(int state, void *ptr) {
-	PeerConnection *p = static_cast<PeerConnection *>(ptr);
-	if (p)
-		p->triggerStateChange(static_cast<State>(state));
+EMSCRIPTEN_KEEPALIVE void rtcDispatchSignalingStateChange(int pc, int state, void *ptr) {
+	rtc::impl::Dispatch::PeerConnectionSignalingStateChange(pc, state, ptr);
+}
+}
+
+namespace rtc::impl {
+
+void Dispatch::PeerConnectionDataChannel(int pc, int dc, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId != pc)
+			return;
+
+		using Kind = rtc::capi::Handle::Kind;
+		auto *d = rtc::capi::CreateHandle(Kind::DataChannel, dc, h->ops);
+		webrtcSetUserPointer(dc, rtc::capi::ToUserPointer(d));
+		if (h->dataChannelCallback)
+			h->dataChannelCallback(h->id, d->id, h->user);
+		return;
+	}
+
+	auto *p = static_cast<rtc::PeerConnection *>(ptr);
+	if (p && p->mId == pc)
+		p->triggerDataChannel(std::make_shared<rtc::DataChannel>(dc));
+}
+
+void Dispatch::PeerConnectionLocalDescription(int pc, const char *sdp, const char *type,
+                                              void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == pc && h->localDescriptionCallback)
+			h->localDescriptionCallback(h->id, sdp, type, h->user);
+		return;
+	}
+
+	auto *p = static_cast<rtc::PeerConnection *>(ptr);
+	if (p && p->mId == pc)
+		p->triggerLocalDescription(rtc::Description(sdp, type));
+}
+
+void Dispatch::PeerConnectionLocalCandidate(int pc, const char *candidate, const char *mid,
+                                            void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == pc && h->localCandidateCallback)
+			h->localCandidateCallback(h->id, candidate, mid, h->user);
+		return;
+	}
+
+	auto *p = static_cast<rtc::PeerConnection *>(ptr);
+	if (p && p->mId == pc)
+		p->triggerLocalCandidate(rtc::Candidate(candidate, mid));
+}
+
+void Dispatch::PeerConnectionStateChange(int pc, int state, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == pc && h->stateChangeCallback)
+			h->stateChangeCallback(h->id, static_cast<rtcState>(state), h->user);
+		return;
+	}
+
+	auto *p = static_cast<rtc::PeerConnection *>(ptr);
+	if (p && p->mId == pc)
+		p->triggerStateChange(static_cast<rtc::PeerConnection::State>(state));
 }
 
-void PeerConnection::IceStateChangeCallback(int state, void *ptr) {
-	PeerConnection *p = static_cast<PeerConnection *>(ptr);
-	if (p)
-		p->triggerIceStateChange(static_cast<IceState>(state));
+void Dispatch::PeerConnectionIceStateChange(int pc, int state, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == pc && h->iceStateChangeCallback)
+			h->iceStateChangeCallback(h->id, static_cast<rtcIceState>(state), h->user);
+		return;
+	}
+
+	auto *p = static_cast<rtc::PeerConnection *>(ptr);
+	if (p && p->mId == pc)
+		p->triggerIceStateChange(static_cast<rtc::PeerConnection::IceState>(state));
 }
 
-void PeerConnection::GatheringStateChangeCallback(int state, void *ptr) {
-	PeerConnection *p = static_cast<PeerConnection *>(ptr);
-	if (p)
-		p->triggerGatheringStateChange(static_cast<GatheringState>(state));
+void Dispatch::PeerConnectionGatheringStateChange(int pc, int state, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == pc && h->gatheringStateCallback)
+			h->gatheringStateCallback(h->id, static_cast<rtcGatheringState>(state), h->user);
+		return;
+	}
+
+	auto *p = static_cast<rtc::PeerConnection *>(ptr);
+	if (p && p->mId == pc)
+		p->triggerGatheringStateChange(static_cast<rtc::PeerConnection::GatheringState>(state));
 }
 
-void PeerConnection::SignalingStateChangeCallback(int state, void *ptr) {
-	PeerConnection *p = static_cast<PeerConnection *>(ptr);
-	if (p)
-		p->triggerSignalingStateChange(static_cast<SignalingState>(state));
+void Dispatch::PeerConnectionSignalingStateChange(int pc, int state, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == pc && h->signalingStateCallback)
+			h->signalingStateCallback(h->id, static_cast<rtcSignalingState>(state), h->user);
+		return;
+	}
+
+	auto *p = static_cast<rtc::PeerConnection *>(ptr);
+	if (p && p->mId == pc)
+		p->triggerSignalingStateChange(static_cast<rtc::PeerConnection::SignalingState>(state));
 }
 
+} // namespace rtc::impl
+
+namespace rtc {
+
+using std::function;
+using std::vector;
+
+PeerConnection::PeerConnection() : PeerConnection(Configuration()) {}
+
 PeerConnection::PeerConnection(const Configuration &config) {
 	vector<string> urls;
 	urls.reserve(config.iceServers.size());
@@ -139,28 +222,28 @@ PeerConnection::PeerConnection(const Configuration &config) {
 		username_ptrs.push_back(iceServer.username.c_str());
 		password_ptrs.push_back(iceServer.password.c_str());
 	}
-	mId = rtcCreatePeerConnection(url_ptrs.data(), username_ptrs.data(), password_ptrs.data(),
-	                              config.iceServers.size());
-	if (!mId)
-		throw std::runtime_error("WebRTC not supported");
+	mId = webrtcCreatePeerConnection(url_ptrs.data(), username_ptrs.data(), password_ptrs.data(),
+	                                 config.iceServers.size(), config.enableTimelineMarks);
+	if (!mId) {
+		RTC_LOG_ERROR("RTCPeerConnection is not available");
+		RTC_THROW(std::runtime_error, "WebRTC not supported");
+	}
 
-	rtcSetUserPointer(mId, this);
-	rtcSetDataChannelCallback(mId, DataChannelCallback);
-	rtcSetLocalDescriptionCallback(mId, DescriptionCallback);
-	rtcSetLocalCandidateCallback(mId, CandidateCallback);
-	rtcSetStateChangeCallback(mId, StateChangeCallback);
-	rtcSetIceStateChangeCallback(mId, IceStateChangeCallback);
-	rtcSetGatheringStateChangeCallback(mId, GatheringStateChangeCallback);
-	rtcSetSignalingStateChangeCallback(mId, SignalingStateChangeCallback);
+	RTC_LOG_DEBUG("Created PeerConnection ", mId, " with ", urls.size(), " ICE servers");
+	webrtcSetUserPointer(mId, this);
 }
 
 PeerConnection::~PeerConnection() { close(); }
 
 void PeerConnection::close() {
 	if (mId) {
-		rtcDeletePeerConnection(mId);
+		RTC_LOG_DEBUG("Closing PeerConnection ", mId);
+		webrtcDeletePeerConnection(mId);
 		mId = 0;
 	}
+	mHeartbeat.reset();
+	mReorderWindow.reset();
+	mPendingLocalCandidates.clear();
 }
 
 PeerConnection::State PeerConnection::state() const { return mState; }
@@ -175,8 +258,8 @@ optional<Description> PeerConnection::localDescription() const {
 	if (!mId)
 		return std::nullopt;
 
-	char *sdp = rtcGetLocalDescription(mId);
-	char *type = rtcGetLocalDescriptionType(mId);
+	char *sdp = webrtcGetLocalDescription(mId);
+	char *type = webrtcGetLocalDescriptionType(mId);
 	if (!sdp || !type) {
 		free(sdp);
 		free(type);
@@ -192,8 +275,8 @@ optional<Description> PeerConnection::remoteDescription() const {
 	if (!mId)
 		return std::nullopt;
 
-	char *sdp = rtcGetRemoteDescription(mId);
-	char *type = rtcGetRemoteDescriptionType(mId);
+	char *sdp = webrtcGetRemoteDescription(mId);
+	char *type = webrtcGetRemoteDescriptionType(mId);
 	if (!sdp || !type) {
 		free(sdp);
 		free(type);
@@ -205,35 +288,200 @@ optional<Description> PeerConnection::remoteDescription() const {
 	return description;
 }
 
+PeerConnection::Timeline PeerConnection::timeline() const {
+	Timeline timeline;
+	if (!mId)
+		return timeline;
+
+	int count = webrtcGetTimeline(mId, nullptr, 0);
+	if (count <= 0)
+		return timeline;
+
+	vector<double> entries(size_t(count) * 3);
+	count = std::min(count, webrtcGetTimeline(mId, entries.data(), count));
+	for (int i = 0; i < count; ++i) {
+		int event = int(entries[i * 3]);
+		int value = int(entries[i * 3 + 1]);
+		double time = entries[i * 3 + 2];
+		switch (event) {
+		case 0:
+			timeline.created = time;
+			break;
+		case 1:
+			if (!timeline.localDescription)
+				timeline.localDescription = time;
+			break;
+		case 2:
+			if (!timeline.firstLocalCandidate)
+				timeline.firstLocalCandidate = time;
+			timeline.lastLocalCandidate = time;
+			break;
+		case 3:
+			if (!timeline.remoteDescription)
+				timeline.remoteDescription = time;
+			break;
+		case 4:
+			timeline.stateChanges.emplace_back(static_cast<State>(value), time);
+			break;
+		case 5:
+			timeline.iceStateChanges.emplace_back(static_cast<IceState>(value), time);
+			break;
+		case 6:
+			timeline.gatheringStateChanges.emplace_back(static_cast<GatheringState>(value), time);
+			break;
+		case 7: {
+			char str[256];
+			if (webrtcGetTimelineLabel(mId, value, str, 256) >= 0)
+				timeline.dataChannelOpens.emplace_back(string(str), time);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return timeline;
+}
+
 shared_ptr<DataChannel> PeerConnection::createDataChannel(const string &label,
                                                           DataChannelInit init) {
+	auto dataChannel = openDataChannel(label, init);
+	if (mScheduler)
+		dataChannel->attachScheduler(mScheduler,
+		                             init.weight ? init.weight : 1u << int(init.priority));
+
+	return dataChannel;
+}
+
+shared_ptr<DataChannel> PeerConnection::openDataChannel(const string &label,
+                                                        const DataChannelInit &init) {
 	if (!mId)
-		throw std::runtime_error("Peer connection is closed");
+		RTC_THROW(std::runtime_error, "Peer connection is closed");
 
 	const Reliability &reliability = init.reliability;
 	if (reliability.maxPacketLifeTime && reliability.maxRetransmits)
-		throw std::invalid_argument("Both maxPacketLifeTime and maxRetransmits are set");
+		RTC_THROW(std::invalid_argument, "Both maxPacketLifeTime and maxRetransmits are set");
+
+	if (init.negotiated && !init.id)
+		RTC_THROW(std::invalid_argument, "A negotiated DataChannel requires an id");
 
 	int maxRetransmits = reliability.maxRetransmits ? int(*reliability.maxRetransmits) : -1;
 	int maxPacketLifeTime =
 	    reliability.maxPacketLifeTime ? int(reliability.maxPacketLifeTime->count()) : -1;
+	int id = init.negotiated ? int(*init.id) : -1;
 
-	return std::make_shared<DataChannel>(rtcCreateDataChannel(
-	    mId, label.c_str(), init.reliability.unordered, maxRetransmits, maxPacketLifeTime));
+	int dc = webrtcCreateDataChannel(mId, label.c_str(), reliability.unordered, maxRetransmits,
+	                                 maxPacketLifeTime, int(init.priority), id);
+	return std::make_shared<DataChannel>(dc);
+}
+
+void PeerConnection::enableSendScheduler(SendSchedulerInit init) {
+	mScheduler = std::make_shared<SendScheduler>(std::move(init));
+}
+
+void PeerConnection::enableHeartbeat(HeartbeatInit init) {
+	if (init.interval.count() <= 0 || init.missThreshold == 0)
+		RTC_THROW(std::invalid_argument, "Invalid heartbeat interval or miss threshold");
+
+	// Heartbeats must not be delayed by retransmissions or queued behind other channels, so
+	// the channel is unordered without retransmissions and bypasses the send scheduler
+	DataChannelInit channelInit;
+	channelInit.reliability.unordered = true;
+	channelInit.reliability.maxRetransmits = 0;
+	channelInit.priority = Priority::High;
+	channelInit.negotiated = true;
+	channelInit.id = init.id;
+	auto channel = openDataChannel("heartbeat", channelInit);
+
+	mHeartbeat = std::make_shared<Heartbeat>(this, init, std::move(channel));
+	mHeartbeat->start();
+}
+
+optional<std::chrono::microseconds> PeerConnection::roundTripTime() const {
+	return mHeartbeat ? mHeartbeat->roundTripTime() : std::nullopt;
+}
+
+bool PeerConnection::isPeerResponsive() const {
+	return mHeartbeat ? mHeartbeat->isResponsive() : true;
+}
+
+void PeerConnection::setCandidatePolicy(CandidatePolicy policy) {
+	mCandidatePolicy = std::move(policy);
 }
 
 void PeerConnection::setRemoteDescription(const Description &description) {
 	if (!mId)
-		throw std::runtime_error("Peer connection is closed");
+		RTC_THROW(std::runtime_error, "Peer connection is closed");
 
-	rtcSetRemoteDescription(mId, string(description).c_str(), description.typeString().c_str());
+	webrtcSetRemoteDescription(mId, string(description).c_str(), description.typeString().c_str());
 }
 
 void PeerConnection::addRemoteCandidate(const Candidate &candidate) {
 	if (!mId)
-		throw std::runtime_error("Peer connection is closed");
+		RTC_THROW(std::runtime_error, "Peer connection is closed");
+
+	if (mCandidatePolicy.remote && mCandidatePolicy.filter && !mCandidatePolicy.filter(candidate)) {
+		RTC_LOG_VERBOSE("Dropped remote candidate ", candidate.candidate());
+		return;
+	}
+
+	webrtcAddRemoteCandidate(mId, candidate.candidate().c_str(), candidate.mid().c_str());
+}
+
+void PeerConnection::addRemoteCandidates(std::vector<Candidate> candidates) {
+	if (!mId)
+		RTC_THROW(std::runtime_error, "Peer connection is closed");
+
+	if (mCandidatePolicy.remote)
+		applyCandidatePolicy(candidates);
+
+	for (const Candidate &candidate : candidates)
+		webrtcAddRemoteCandidate(mId, candidate.candidate().c_str(), candidate.mid().c_str());
+}
+
+void PeerConnection::applyCandidatePolicy(std::vector<Candidate> &candidates) const {
+	if (const auto &filter = mCandidatePolicy.filter) {
+		auto it = std::remove_if(candidates.begin(), candidates.end(),
+		                         [&filter](const Candidate &c) { return !filter(c); });
+		RTC_LOG_VERBOSE("Dropped ", candidates.end() - it, " candidates");
+		candidates.erase(it, candidates.end());
+	}
+
+	if (const auto &preference = mCandidatePolicy.preference) {
+		// Evaluate each preference once, then keep the original order between equal ones
+		std::vector<std::pair<int, size_t>> keys;
+		keys.reserve(candidates.size());
+		for (size_t i = 0; i < candidates.size(); ++i)
+			keys.emplace_back(-preference(candidates[i]), i);
+
+		std::stable_sort(keys.begin(), keys.end());
+		std::vector<Candidate> sorted;
+		sorted.reserve(candidates.size());
+		for (const auto &key : keys)
+			sorted.push_back(std::move(candidates[key.second]));
 
-	rtcAddRemoteCandidate(mId, candidate.candidate().c_str(), candidate.mid().c_str());
+		candidates = std::move(sorted);
+	}
+}
+
+void PeerConnection::FlushLocalCandidates(void *arg) {
+	// Timers cannot be cancelled, so they only hold a weak reference to the window
+	std::unique_ptr<std::weak_ptr<PeerConnection *>> weak(
+	    static_cast<std::weak_ptr<PeerConnection *> *>(arg));
+	if (auto window = weak->lock())
+		(*window)->flushLocalCandidates();
+}
+
+void PeerConnection::flushLocalCandidates() {
+	mReorderWindow.reset();
+	if (mPendingLocalCandidates.empty())
+		return;
+
+	auto candidates = std::move(mPendingLocalCandidates);
+	mPendingLocalCandidates.clear();
+	applyCandidatePolicy(candidates);
+	for (const Candidate &candidate : candidates)
+		if (mLocalCandidateCallback)
+			mLocalCandidateCallback(candidate);
 }
 
 void PeerConnection::onDataChannel(function<void(shared_ptr<DataChannel>)> callback) {
@@ -264,7 +512,22 @@ void PeerConnection::onSignalingStateChange(function<void(SignalingState state)>
 	mSignalingStateChangeCallback = callback;
 }
 
+void PeerConnection::onPeerUnresponsive(function<void()> callback) {
+	mPeerUnresponsiveCallback = callback;
+}
+
+void PeerConnection::onPeerResponsive(function<void()> callback) {
+	mPeerResponsiveCallback = callback;
+}
+
+void PeerConnection::onRoundTripTime(function<void(std::chrono::microseconds rtt)> callback) {
+	mRoundTripTimeCallback = callback;
+}
+
 void PeerConnection::triggerDataChannel(shared_ptr<DataChannel> dataChannel) {
+	if (mScheduler)
+		dataChannel->attachScheduler(mScheduler, 1u << int(dataChannel->priority()));
+
 	if (mDataChannelCallback)
 		mDataChannelCallback(dataChannel);
 }
@@ -275,6 +538,23 @@ void PeerConnection::triggerLocalDescription(const Description &description) {
 }
 
 void PeerConnection::triggerLocalCandidate(const Candidate &candidate) {
+	if (mCandidatePolicy.local) {
+		if (mCandidatePolicy.filter && !mCandidatePolicy.filter(candidate)) {
+			RTC_LOG_VERBOSE("Dropped local candidate ", candidate.candidate());
+			return;
+		}
+		if (mCandidatePolicy.preference && mCandidatePolicy.reorderWindow.count() > 0) {
+			mPendingLocalCandidates.push_back(candidate);
+			if (!mReorderWindow) {
+				mReorderWindow = std::make_shared<PeerConnection *>(this);
+				emscripten_async_call(FlushLocalCandidates,
+				                      new std::weak_ptr<PeerConnection *>(mReorderWindow),
+				                      int(mCandidatePolicy.reorderWindow.count()));
+			}
+			return;
+		}
+	}
+
 	if (mLocalCandidateCallback)
 		mLocalCandidateCallback(candidate);
 }
@@ -293,6 +573,11 @@ void PeerConnection::triggerIceStateChange(IceState state) {
 
 void PeerConnection::triggerGatheringStateChange(GatheringState state) {
 	mGatheringState = state;
+	if (state == GatheringState::Complete) {
+		// Candidates held for ordering are delivered before gathering is reported complete
+		flushLocalCandidates();
+	}
+
 	if (mGatheringStateChangeCallback)
 		mGatheringStateChangeCallback(state);
 }
@@ -303,6 +588,22 @@ void PeerConnection::triggerSignalingStateChange(SignalingState state) {
 		mSignalingStateChangeCallback(state);
 }
 
+void PeerConnection::triggerPeerUnresponsive() {
+	if (mPeerUnresponsiveCallback)
+		mPeerUnresponsiveCallback();
+}
+
+void PeerConnection::triggerPeerResponsive() {
+	if (mPeerResponsiveCallback)
+		mPeerResponsiveCallback();
+}
+
+void PeerConnection::triggerRoundTripTime(std::chrono::microseconds rtt) {
+	if (mRoundTripTimeCallback)
+		mRoundTripTimeCallback(rtt);
+}
+
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, PeerConnection::State state) {
 	using State = PeerConnection::State;
 	const char *str;
@@ -409,5 +710,6 @@ std::ostream &operator<<(std::ostream &out, PeerConnection::SignalingState state
 	}
 	return out << str;
 }
+#endif
 
 } // namespace rtc
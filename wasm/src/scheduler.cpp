@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+namespace rtc {
+
+SendScheduler::SendScheduler(SendSchedulerInit init) : mInit(std::move(init)) {}
+
+void SendScheduler::attach(DataChannel *channel, unsigned int weight) {
+	Flow &flow = mFlows[channel];
+	flow.weight = std::max(weight, 1u);
+	updateThresholds();
+}
+
+void SendScheduler::detach(DataChannel *channel) {
+	auto it = mFlows.find(channel);
+	if (it == mFlows.end())
+		return;
+
+	mBufferedAmount -= it->second.bufferedAmount;
+	mFlows.erase(it);
+	mActive.erase(std::remove(mActive.begin(), mActive.end(), channel), mActive.end());
+	updateThresholds();
+}
+
+bool SendScheduler::admit(DataChannel *channel, size_t size) const {
+	auto it = mFlows.find(channel);
+	if (it == mFlows.end())
+		return true;
+
+	// Never overtake messages already queued on the same channel
+	return it->second.queue.empty() && mBufferedAmount + size <= mInit.maxBufferedAmount;
+}
+
+bool SendScheduler::enqueue(DataChannel *channel, MessageBuffer data,
+                            std::optional<uint32_t> key) {
+	auto it = mFlows.find(channel);
+	if (it == mFlows.end())
+		return false;
+
+	Flow &flow = it->second;
+	if (key) {
+		auto jt = std::find_if(flow.queue.begin(), flow.queue.end(),
+		                       [&key](const Entry &entry) { return entry.key == key; });
+		if (jt != flow.queue.end()) {
+			flow.queuedAmount = flow.queuedAmount - jt->data.size() + data.size();
+			jt->data = std::move(data);
+			return true;
+		}
+	}
+
+	bool wasQueued = !flow.queue.empty();
+	flow.queuedAmount += data.size();
+	flow.queue.push_back(Entry{std::move(data), key});
+	if (!wasQueued)
+		mActive.push_back(channel);
+
+	flush();
+	return true;
+}
+
+void SendScheduler::update(DataChannel *channel, size_t bufferedAmount) {
+	auto it = mFlows.find(channel);
+	if (it == mFlows.end())
+		return;
+
+	Flow &flow = it->second;
+	mBufferedAmount -= flow.bufferedAmount;
+	flow.bufferedAmount = bufferedAmount;
+	mBufferedAmount += flow.bufferedAmount;
+}
+
+void SendScheduler::reserve(DataChannel *channel, size_t size) {
+	auto it = mFlows.find(channel);
+	if (it == mFlows.end())
+		return;
+
+	it->second.bufferedAmount += size;
+	mBufferedAmount += size;
+}
+
+size_t SendScheduler::queuedAmount(const DataChannel *channel) const {
+	auto it = mFlows.find(const_cast<DataChannel *>(channel));
+	return it != mFlows.end() ? it->second.queuedAmount : 0;
+}
+
+void SendScheduler::flush() {
+	// Deficit round robin over queued channels, weighted by channel weight
+	while (!mActive.empty()) {
+		if (mBufferedAmount >= mInit.maxBufferedAmount)
+			return;
+
+		DataChannel *channel = mActive.front();
+		mActive.pop_front();
+		Flow &flow = mFlows[channel];
+		size_t quantum = mInit.quantum * flow.weight;
+		if (!flow.resuming)
+			flow.deficit += quantum;
+
+		flow.resuming = false;
+
+		bool full = false;
+		auto &queue = flow.queue;
+		while (!queue.empty() && queue.front().data.size() <= flow.deficit) {
+			if (mBufferedAmount >= mInit.maxBufferedAmount) {
+				full = true;
+				break;
+			}
+
+			MessageBuffer data = std::move(queue.front().data);
+			queue.pop_front();
+			flow.deficit -= data.size();
+			flow.queuedAmount -= data.size();
+			auto str = reinterpret_cast<const char *>(data.data());
+			if (!channel->sendNow(str, data.size(), data.isString())) {
+				queue.clear();
+				flow.queuedAmount = 0;
+			}
+		}
+
+		if (queue.empty()) {
+			flow.deficit = 0;
+			continue;
+		}
+
+		// A flow never carries more than a round's worth of credit, or what its next message
+		// needs, so that it cannot burst past its share after being held back
+		flow.deficit = std::min(flow.deficit, std::max(quantum, queue.front().data.size()));
+		if (full) {
+			// Keep its turn so the channel resumes first on the next flush
+			flow.resuming = true;
+			mActive.push_front(channel);
+			return;
+		}
+
+		mActive.push_back(channel);
+	}
+}
+
+void SendScheduler::updateThresholds() {
+	// With every channel at or below its threshold, the total is at most half the limit, so a
+	// low event is guaranteed to fire before the scheduler could stall with queued messages.
+	if (mFlows.empty())
+		return;
+
+	size_t threshold = mInit.maxBufferedAmount / (2 * mFlows.size());
+	for (auto &[channel, flow] : mFlows)
+		channel->setLowThreshold(threshold);
+}
+
+} // namespace rtc
@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2017-2024 Paul-Louis Ageneau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RTC_SCHEDULER_H
+#define RTC_SCHEDULER_H
+
+#include "datachannel.hpp"
+#include "message.hpp"
+#include "peerconnection.hpp"
+
+#include <deque>
+#include <optional>
+#include <unordered_map>
+
+namespace rtc {
+
+// Weighted fair scheduler metering sends from the data channels of a PeerConnection. It keeps
+// the total amount buffered in the browser under a limit, queueing the excess per channel and
+// releasing it by deficit round robin when channels report their buffered amount going low.
+class SendScheduler final {
+public:
+	explicit SendScheduler(SendSchedulerInit init);
+
+	void attach(DataChannel *channel, unsigned int weight);
+	void detach(DataChannel *channel);
+
+	// Whether a message of this size may be handed to the browser right away
+	bool admit(DataChannel *channel, size_t size) const;
+
+	// A keyed message replaces the queued message with the same key, if any, in its position
+	bool enqueue(DataChannel *channel, MessageBuffer data,
+	             std::optional<uint32_t> key = std::nullopt);
+
+	// Update the amount buffered in the browser for the channel, as returned by the glue
+	void update(DataChannel *channel, size_t bufferedAmount);
+
+	// Account for a send in flight before its result is known
+	void reserve(DataChannel *channel, size_t size);
+
+	size_t queuedAmount(const DataChannel *channel) const;
+	void flush();
+
+private:
+	struct Entry {
+		MessageBuffer data;
+		std::optional<uint32_t> key;
+	};
+
+	struct Flow {
+		unsigned int weight = 1;
+		std::deque<Entry> queue;
+		size_t queuedAmount = 0;
+		size_t deficit = 0;
+		size_t bufferedAmount = 0;
+		bool resuming = false; // Interrupted mid-round, the quantum was already granted
+	};
+
+	void updateThresholds();
+
+	const SendSchedulerInit mInit;
+	std::unordered_map<DataChannel *, Flow> mFlows;
+	std::deque<DataChannel *> mActive;
+	size_t mBufferedAmount = 0;
+};
+
+} // namespace rtc
+
+#endif // RTC_SCHEDULER_H
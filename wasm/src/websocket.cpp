@@ -21,6 +21,9 @@
  */
 
 #include "websocket.hpp"
+#include "capi.hpp"
+#include "dispatch.hpp"
+#include "log.hpp"
 
 #include <emscripten/emscripten.h>
 
@@ -30,47 +33,117 @@
 extern "C" {
 extern int wsCreateWebSocket(const char *url);
 extern void wsDeleteWebSocket(int ws);
-extern void wsSetOpenCallback(int ws, void (*openCallback)(void *));
-extern void wsSetErrorCallback(int ws, void (*errorCallback)(const char *, void *));
-extern void wsSetMessageCallback(int ws, void (*messageCallback)(const char *, int, void *));
-extern int wsSendMessage(int ws, const char *buffer, int size);
+extern ptrdiff_t wsSendMessage(int ws, const char *buffer, size_t size, int isString);
+extern int wsSendObject(int ws, int object, size_t chunkSize, void *transfer);
 extern char *wsGetWebSocketUrl(int ws);
 extern int wsGetWebSocketState(int ws);
+extern ptrdiff_t wsGetBufferedAmount(int ws);
+extern void wsSetBufferedAmountLowThreshold(int ws, size_t threshold);
+extern void wsSetReceivePaused(int ws, int paused);
+extern int wsIsStreamBackend(int ws);
 extern void wsSetUserPointer(int ws, void *ptr);
+
+EMSCRIPTEN_KEEPALIVE void wsDispatchOpen(int ws, void *ptr) {
+	rtc::impl::Dispatch::WebSocketOpen(ws, ptr);
 }
 
-namespace rtc {
+EMSCRIPTEN_KEEPALIVE void wsDispatchError(int ws, const char *error, void *ptr) {
+	rtc::impl::Dispatch::WebSocketError(ws, error, ptr);
+}
+
+EMSCRIPTEN_KEEPALIVE void wsDispatchMessage(int ws, char *data, ptrdiff_t size, void *ptr) {
+	rtc::impl::Dispatch::WebSocketMessage(ws, data, size, ptr);
+}
+
+EMSCRIPTEN_KEEPALIVE void wsDispatchBufferedAmountLow(int ws, void *ptr) {
+	rtc::impl::Dispatch::WebSocketBufferedAmountLow(ws, ptr);
+}
+}
+
+namespace rtc::impl {
+
+void Dispatch::WebSocketOpen(int ws, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == ws)
+			rtc::capi::DispatchOpen(h);
+		return;
+	}
 
-void WebSocket::OpenCallback(void *ptr) {
-	WebSocket *w = static_cast<WebSocket *>(ptr);
-	if (w)
+	auto *w = static_cast<rtc::WebSocket *>(ptr);
+	if (w && w->mId == ws) {
+		w->recordCrossing();
 		w->triggerOpen();
+	}
 }
 
-void WebSocket::ErrorCallback(const char *error, void *ptr) {
-	WebSocket *w = static_cast<WebSocket *>(ptr);
-	if (w)
-		w->triggerError(string(error ? error : "unknown"));
+void Dispatch::WebSocketError(int ws, const char *error, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == ws)
+			rtc::capi::DispatchError(h, error);
+		return;
+	}
+
+	auto *w = static_cast<rtc::WebSocket *>(ptr);
+	if (w && w->mId == ws) {
+		w->recordCrossing();
+		rtc::string message(error ? error : "unknown");
+		RTC_LOG_WARNING("WebSocket error: ", message);
+		w->triggerError(std::move(message));
+	}
 }
 
-void WebSocket::MessageCallback(const char *data, int size, void *ptr) {
-	WebSocket *w = static_cast<WebSocket *>(ptr);
-	if (w) {
-		if (data) {
-			if (size >= 0) {
-				auto b = reinterpret_cast<const byte *>(data);
-				w->triggerMessage(binary(b, b + size));
-			} else {
-				w->triggerMessage(string(data));
-			}
-		} else {
+void Dispatch::WebSocketMessage(int ws, char *data, ptrdiff_t size, void *ptr) {
+	auto *h = rtc::capi::FromUserPointer(ptr);
+	auto *w = h ? nullptr : static_cast<rtc::WebSocket *>(ptr);
+	if (!data) {
+		if (h && h->glueId == ws)
+			rtc::capi::DispatchClosed(h);
+		if (w && w->mId == ws) {
+			w->recordCrossing();
 			w->close();
 			w->triggerClosed();
 		}
+		return;
+	}
+
+	// The glue allocated data with rtcAllocMessageBuffer, ownership is taken in any case. Strings
+	// are passed as -(length + 1) so that the exact allocation size is known even if they
+	// contain null characters.
+	using Type = rtc::MessageBuffer::Type;
+	auto *b = reinterpret_cast<rtc::byte *>(data);
+	bool isString = size < 0;
+	size_t capacity = isString ? size_t(-size) : size_t(size);
+	size_t length = isString ? capacity - 1 : capacity;
+	auto buffer = rtc::MessageBuffer::Adopt(b, length, capacity,
+	                                        isString ? Type::String : Type::Binary);
+	if (h && h->glueId == ws) {
+		rtc::capi::DispatchMessage(h, buffer);
+	} else if (w && w->mId == ws) {
+		w->recordCrossing();
+		w->triggerMessageBuffer(std::move(buffer));
 	}
 }
 
-WebSocket::WebSocket() : mId(0), mConnected(false) {}
+void Dispatch::WebSocketBufferedAmountLow(int ws, void *ptr) {
+	if (auto *h = rtc::capi::FromUserPointer(ptr)) {
+		if (h->glueId == ws)
+			rtc::capi::DispatchBufferedAmountLow(h);
+		return;
+	}
+
+	auto *w = static_cast<rtc::WebSocket *>(ptr);
+	if (w && w->mId == ws) {
+		w->recordCrossing();
+		w->triggerBufferedAmountLow();
+	}
+}
+
+} // namespace rtc::impl
+
+namespace rtc {
+
+WebSocket::WebSocket()
+    : mId(0), mConnected(false), mBufferedAmountLowThreshold(0), mReceivePaused(false) {}
 
 WebSocket::~WebSocket() { close(); }
 
@@ -78,13 +151,18 @@ void WebSocket::open(const string &url) {
 	close();
 
 	mId = wsCreateWebSocket(url.c_str());
-	if (!mId)
-		throw std::runtime_error("WebSocket not supported");
+	if (!mId) {
+		RTC_LOG_ERROR("WebSocket is not available");
+		RTC_THROW(std::runtime_error, "WebSocket not supported");
+	}
+
+	RTC_LOG_DEBUG("Opening WebSocket ", mId, " to ", url);
 
 	wsSetUserPointer(mId, this);
-	wsSetOpenCallback(mId, OpenCallback);
-	wsSetErrorCallback(mId, ErrorCallback);
-	wsSetMessageCallback(mId, MessageCallback);
+	if (mBufferedAmountLowThreshold > 0)
+		wsSetBufferedAmountLowThreshold(mId, mBufferedAmountLowThreshold);
+	if (mReceivePaused)
+		wsSetReceivePaused(mId, 1);
 }
 
 void WebSocket::close() {
@@ -99,24 +177,73 @@ bool WebSocket::isOpen() const { return mConnected; }
 
 bool WebSocket::isClosed() const { return mId == 0; }
 
+size_t WebSocket::bufferedAmount() const {
+	if (!mId)
+		return 0;
+
+	ptrdiff_t ret = wsGetBufferedAmount(mId);
+	recordCrossing();
+	if (ret < 0)
+		return 0;
+
+	recordBufferedAmount(size_t(ret));
+	return size_t(ret);
+}
+
 bool WebSocket::send(message_variant message) {
 	if (!mId)
 		return false;
 
-	return std::visit(
-	    overloaded{[this](const binary &b) {
-		               auto data = reinterpret_cast<const char *>(b.data());
-		               return wsSendMessage(mId, data, int(b.size())) >= 0;
-	               },
-	               [this](const string &s) { return wsSendMessage(mId, s.c_str(), -1) >= 0; }},
-	    std::move(message));
+	return std::visit(overloaded{[this](const binary &b) {
+		                             auto data = reinterpret_cast<const char *>(b.data());
+		                             captureSend(b.data(), b.size(), false);
+		                             ptrdiff_t ret = wsSendMessage(mId, data, b.size(), 0);
+		                             recordSend(b.size(), ret);
+		                             return ret >= 0;
+	                             },
+	                             [this](const string &s) {
+		                             auto data = reinterpret_cast<const byte *>(s.data());
+		                             captureSend(data, s.size(), true);
+		                             ptrdiff_t ret = wsSendMessage(mId, s.c_str(), s.size(), 1);
+		                             recordSend(s.size(), ret);
+		                             return ret >= 0;
+	                             }},
+	                  std::move(message));
 }
 
 bool WebSocket::send(const byte *data, size_t size) {
 	if (!mId)
 		return false;
 
-	return wsSendMessage(mId, reinterpret_cast<const char *>(data), int(size)) >= 0;
+	captureSend(data, size, false);
+	ptrdiff_t ret = wsSendMessage(mId, reinterpret_cast<const char *>(data), size, 0);
+	recordSend(size, ret);
+	return ret >= 0;
+}
+
+bool WebSocket::send(const MessageBuffer &data) {
+	if (!mId)
+		return false;
+
+	// String buffers are null-terminated, so they can be passed to the glue as is
+	auto str = reinterpret_cast<const char *>(data.data());
+	captureSend(data.data(), data.size(), data.isString());
+	ptrdiff_t ret = wsSendMessage(mId, str, data.size(), data.isString());
+	recordSend(data.size(), ret);
+	return ret >= 0;
+}
+
+bool WebSocket::sendObject(ObjectHandle object, TransferInit init) {
+	if (!mId || init.chunkSize == 0)
+		return false;
+
+	// Released by the glue on completion
+	auto transfer = new TransferInit(std::move(init));
+	if (!wsSendObject(mId, object, transfer->chunkSize, transfer)) {
+		delete transfer;
+		return false;
+	}
+	return true;
 }
 
 WebSocket::State WebSocket::readyState() const {
@@ -138,11 +265,31 @@ optional<string> WebSocket::url() const {
 	return std::nullopt;
 }
 
+void WebSocket::setBufferedAmountLowThreshold(size_t amount) {
+	mBufferedAmountLowThreshold = amount;
+	if (!mId)
+		return;
+
+	wsSetBufferedAmountLowThreshold(mId, amount);
+}
+
+void WebSocket::setReceivePaused(bool paused) {
+	mReceivePaused = paused;
+	if (!mId)
+		return;
+
+	wsSetReceivePaused(mId, paused ? 1 : 0);
+}
+
+bool WebSocket::hasReceiveBackpressure() const { return mId && wsIsStreamBackend(mId); }
+
 void WebSocket::triggerOpen() {
+	RTC_LOG_DEBUG("WebSocket ", mId, " open");
 	mConnected = true;
 	Channel::triggerOpen();
 }
 
+#ifndef RTC_NO_IOSTREAM
 std::ostream &operator<<(std::ostream &out, WebSocket::State state) {
 	using State = WebSocket::State;
 	const char *str;
@@ -165,5 +312,6 @@ std::ostream &operator<<(std::ostream &out, WebSocket::State state) {
 	}
 	return out << str;
 }
+#endif
 
 } // namespace rtc